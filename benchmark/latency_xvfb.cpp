@@ -0,0 +1,432 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* End-to-end injection latency against a headless X server.
+ *
+ * Every path injects events through the library and waits for them to
+ * come back through an XRecord listener on a separate connection. The
+ * latency is measured from the call to the moment the listener sees
+ * the last event of the call. The throughput pass injects all calls
+ * back to back and measures until the last event is seen.
+ *
+ * usage: latency_xvfb [--display :N] [--calls N]
+ *
+ * Without --display an Xvfb server is started on a free display and
+ * killed on exit, so no GPU or desktop session is needed. Build on Linux
+ * against Xlib, XTest and XRecord:
+ *
+ *   g++ -O2 -std=c++17 -DUNIX -I.. latency_xvfb.cpp -lX11 -lXtst -lpthread
+ *
+ * The output has one line per path with calls, events per call,
+ * p50, p99 and max latency in microseconds and sustained events per second.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/record.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fakeinput/fakeinput.hpp"
+
+using namespace FakeInput;
+
+namespace
+{
+    /** Nanoseconds to wait for an injected event before it counts as lost, one second */
+    constexpr std::int64_t Timeout = 1000000000;
+
+    /** Counts device events of one type seen by the X server.
+     *
+     * The arrival time of every matching event is stored, the injecting
+     * thread waits on the count.
+     */
+    class Listener
+    {
+    public:
+        /** Connects the listener.
+         *
+         * @param capacity
+         *      Most events one expect() will count, the arrival times
+         *      are sized once, before the record thread runs.
+         */
+        bool start(const char* name, std::size_t capacity)
+        {
+            arrivals_.resize(capacity);
+            control_ = XOpenDisplay(name);
+            data_ = XOpenDisplay(name);
+            int major = 0;
+            int minor = 0;
+            if (!control_ || !data_ || !XRecordQueryVersion(control_, &major, &minor))
+            {
+                std::fprintf(stderr, "XRecord extension is not available\n");
+                return false;
+            }
+
+            XRecordRange* range = XRecordAllocRange();
+            range->device_events.first = KeyPress;
+            range->device_events.last = MotionNotify;
+            XRecordClientSpec clients = XRecordAllClients;
+            context_ = XRecordCreateContext(control_, 0, &clients, 1, &range, 1);
+            XFree(range);
+            XSync(control_, False);
+
+            thread_ = std::thread([this] {
+                XRecordEnableContext(data_, context_, &Listener::intercept_, reinterpret_cast<XPointer>(this));
+            });
+            return true;
+        }
+
+        void stop()
+        {
+            if (thread_.joinable())
+            {
+                XRecordDisableContext(control_, context_);
+                XSync(control_, False);
+                thread_.join();
+                XRecordFreeContext(control_, context_);
+            }
+            if (data_)
+            {
+                XCloseDisplay(data_);
+            }
+            if (control_)
+            {
+                XCloseDisplay(control_);
+            }
+        }
+
+        /** Starts counting events of the type from zero.
+         *
+         * @param detail
+         *      Keycode or button to match, 0 matches all.
+         */
+        void expect(int type, int detail)
+        {
+            type_.store(0, std::memory_order_release);
+            seen_.store(0, std::memory_order_relaxed);
+            detail_.store(detail, std::memory_order_relaxed);
+            type_.store(type, std::memory_order_release);
+        }
+
+        /** Waits until count events were seen, @returns false on timeout. */
+        bool waitFor(std::size_t count) const
+        {
+            std::int64_t deadline = monotonicTime() + Timeout;
+            while (seen_.load(std::memory_order_acquire) < count)
+            {
+                if (monotonicTime() > deadline)
+                {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+            return true;
+        }
+
+        std::int64_t arrival(std::size_t index) const
+        {
+            return arrivals_[index];
+        }
+
+    private:
+        static void intercept_(XPointer closure, XRecordInterceptData* data)
+        {
+            Listener* listener = reinterpret_cast<Listener*>(closure);
+            std::int64_t now = monotonicTime();
+
+            if (data->category == XRecordFromServer && data->data_len * 4 >= sizeof(xEvent))
+            {
+                const xEvent* event = reinterpret_cast<const xEvent*>(data->data);
+                int type = event->u.u.type & 0x7F;
+                int detail = listener->detail_.load(std::memory_order_relaxed);
+
+                if (type == listener->type_.load(std::memory_order_acquire) && (detail == 0 || detail == event->u.u.detail))
+                {
+                    std::size_t index = listener->seen_.load(std::memory_order_relaxed);
+                    if (index < listener->arrivals_.size())
+                    {
+                        listener->arrivals_[index] = now;
+                        listener->seen_.store(index + 1, std::memory_order_release);
+                    }
+                }
+            }
+
+            XRecordFreeData(data);
+        }
+
+        Display* control_ = nullptr;
+        Display* data_ = nullptr;
+        XRecordContext context_ = 0;
+        std::thread thread_;
+
+        std::vector<std::int64_t> arrivals_;
+        std::atomic<std::size_t> seen_{ 0 };
+        std::atomic<int> type_{ 0 };
+        std::atomic<int> detail_{ 0 };
+    };
+
+    /** One way of injecting, the call index lets paths alternate directions */
+    struct Path
+    {
+        const char* name;
+        int type; // X event type observed
+        int detail; // keycode or button observed, 0 for any
+        std::size_t eventsPerCall;
+        std::function<void(std::size_t)> inject;
+    };
+
+    std::int64_t percentile(const std::vector<std::int64_t>& sorted, double fraction)
+    {
+        std::size_t index = static_cast<std::size_t>(fraction * (sorted.size() - 1));
+        return sorted[index];
+    }
+
+    void run(Listener& listener, const Path& path, std::size_t calls)
+    {
+        std::size_t events = calls * path.eventsPerCall;
+
+        // latency, one call at a time
+        listener.expect(path.type, path.detail);
+        std::vector<std::int64_t> latencies;
+        latencies.reserve(calls);
+        std::size_t lost = 0;
+        std::size_t target = 0;
+        for (std::size_t i = 0; i < calls; ++i)
+        {
+            target += path.eventsPerCall;
+            std::int64_t start = monotonicTime();
+            path.inject(i);
+            if (!listener.waitFor(target))
+            {
+                ++lost;
+                listener.expect(path.type, path.detail); // count from zero again
+                target = 0;
+                continue;
+            }
+            latencies.push_back(listener.arrival(target - 1) - start);
+        }
+
+        // throughput, all calls back to back
+        listener.expect(path.type, path.detail);
+        std::int64_t start = monotonicTime();
+        for (std::size_t i = 0; i < calls; ++i)
+        {
+            path.inject(i);
+        }
+        bool complete = listener.waitFor(events);
+        double seconds = complete ? (listener.arrival(events - 1) - start) / 1e9 : 0.0;
+
+        std::sort(latencies.begin(), latencies.end());
+        if (latencies.empty())
+        {
+            std::printf("%-20s %8zu %4zu all events lost\n", path.name, calls, path.eventsPerCall);
+            return;
+        }
+
+        std::printf("%-20s %8zu %4zu %10.1f %10.1f %10.1f %12.0f",
+            path.name, calls, path.eventsPerCall,
+            percentile(latencies, 0.50) / 1e3, percentile(latencies, 0.99) / 1e3, latencies.back() / 1e3,
+            complete ? events / seconds : 0.0);
+        if (lost > 0 || !complete)
+        {
+            std::printf("  (%zu calls lost%s)", lost, complete ? "" : ", throughput pass incomplete");
+        }
+        std::printf("\n");
+    }
+
+    /** Starts Xvfb on a free display, @returns its pid or 0.
+     *
+     * Xvfb picks the display itself and writes its number to a pipe once
+     * it accepts connections, so a server already running elsewhere is
+     * never mistaken for it.
+     *
+     * @param name
+     *      Receives the display name.
+     */
+    pid_t startXvfb(std::string& name)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            return 0;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            ::close(fds[0]);
+            std::string fd = std::to_string(fds[1]);
+            execlp("Xvfb", "Xvfb", "-displayfd", fd.c_str(), "-screen", "0", "1280x1024x24", "-nolisten", "tcp", static_cast<char*>(nullptr));
+            std::perror("Cannot start Xvfb");
+            _exit(127);
+        }
+        ::close(fds[1]);
+        if (pid < 0)
+        {
+            ::close(fds[0]);
+            return 0;
+        }
+
+        // the number ends with a newline, end of file means Xvfb exited
+        std::string number;
+        char c = 0;
+        std::int64_t deadline = monotonicTime() + 5 * Timeout;
+        while (c != '\n')
+        {
+            std::int64_t left = deadline - monotonicTime();
+            pollfd readable = { fds[0], POLLIN, 0 };
+            if (left <= 0 || poll(&readable, 1, static_cast<int>(left / 1000000) + 1) <= 0 || ::read(fds[0], &c, 1) != 1)
+            {
+                break;
+            }
+            if (c != '\n')
+            {
+                number += c;
+            }
+        }
+        ::close(fds[0]);
+
+        if (c == '\n' && !number.empty())
+        {
+            name = ":" + number;
+            return pid;
+        }
+
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string name;
+    std::size_t calls = 2000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--display") == 0)
+        {
+            name = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--calls") == 0)
+        {
+            calls = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+
+    pid_t server = 0;
+    if (name.empty())
+    {
+        server = startXvfb(name);
+        if (!server)
+        {
+            std::fprintf(stderr, "Cannot start Xvfb\n");
+            return EXIT_FAILURE;
+        }
+    }
+    setenv("DISPLAY", name.c_str(), 1); // display() connects to the default display
+
+    Key key = CreateKeyFromKeyType(Key_A);
+    Mouse::moveTo(640, 512); // relative moves stay off the screen edges
+
+    constexpr std::size_t BatchSize = 16;
+    std::vector<Path> paths = {
+        { "keyboard.pressKey", KeyPress, key.code_, 1, [key](std::size_t) {
+            Keyboard::pressKey(key);
+            Keyboard::releaseKey(key);
+        } },
+        { "mouse.move", MotionNotify, 0, 1, [](std::size_t i) {
+            Mouse::move(i % 2 ? -1 : 1, 0);
+        } },
+        { "mouse.moveTo", MotionNotify, 0, 1, [](std::size_t i) {
+            Mouse::moveTo(i % 2 ? 600 : 680, 512);
+        } },
+        { "mouse.wheelUp", ButtonPress, 4, 1, [](std::size_t) {
+            Mouse::wheelUp();
+        } },
+        { "mouse.wheelDown", ButtonPress, 5, 1, [](std::size_t) {
+            Mouse::wheelDown();
+        } },
+        { "batch.move", MotionNotify, 0, BatchSize, [](std::size_t i) {
+            InputBatch batch;
+            for (std::size_t j = 0; j < BatchSize; ++j)
+            {
+                batch.move((i + j) % 2 ? -1 : 1, 0);
+            }
+            batch.commit();
+        } },
+        // what Mouse did before the shared connection, one connection per call
+        { "xopendisplay.move", MotionNotify, 0, 1, [name](std::size_t i) {
+            Display* dpy = XOpenDisplay(name.c_str());
+            if (dpy)
+            {
+                XTestFakeRelativeMotionEvent(dpy, i % 2 ? -1 : 1, 0, CurrentTime);
+                XCloseDisplay(dpy);
+            }
+        } },
+    };
+
+    std::size_t eventsPerCall = 0;
+    for (const Path& path : paths)
+    {
+        eventsPerCall = std::max(eventsPerCall, path.eventsPerCall);
+    }
+
+    Listener listener;
+    if (calls == 0 || !listener.start(name.c_str(), calls * eventsPerCall))
+    {
+        listener.stop();
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%-20s %8s %4s %10s %10s %10s %12s\n", "path", "calls", "ev", "p50_us", "p99_us", "max_us", "events_per_s");
+    for (const Path& path : paths)
+    {
+        run(listener, path, calls);
+    }
+
+    listener.stop();
+    if (server)
+    {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+    }
+    return EXIT_SUCCESS;
+}
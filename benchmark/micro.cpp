@@ -0,0 +1,210 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Microbenchmarks of the per-event costs of the library.
+ *
+ * Covers key type translation, key creation with and without KeyCache,
+ * Key copies and building events up to the system call. The system
+ * calls themselves are replaced by stubs, see stub_platform.hpp, so
+ * this builds and runs on any Linux box without an X server:
+ *
+ *   g++ -O2 -std=c++17 -DUNIX -I.. micro.cpp -lpthread
+ *
+ * Prints one JSON object per line:
+ *
+ *   {"benchmark":"translateKey","ns_per_op":0.61,"iterations":16777216}
+ *
+ * ns_per_op is the best of several repetitions, which is the most
+ * stable figure for comparing runs.
+ *
+ * usage: micro [filter]   runs the benchmarks whose name contains filter
+ */
+
+#include "stub_platform.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "fakeinput/fakeinput.hpp"
+
+using namespace FakeInput;
+
+namespace
+{
+    constexpr int Repetitions = 7;
+    constexpr std::uint64_t MinimumTime = 20000000; // ns per repetition
+
+    /** Keeps the compiler from dropping the computation of value */
+    template<typename T>
+    inline void keep(const T& value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile char sink;
+        sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+    }
+
+    /** Runs body(i) for enough iterations and prints the best time per iteration. */
+    template<typename Body_t>
+    void benchmark(const char* name, const char* filter, Body_t body)
+    {
+        if (filter && !std::strstr(name, filter))
+        {
+            return;
+        }
+
+        // grow the iteration count until one repetition takes long enough
+        std::uint64_t iterations = 1024;
+        for (;;)
+        {
+            std::int64_t start = monotonicTime();
+            for (std::uint64_t i = 0; i < iterations; ++i)
+            {
+                body(i);
+            }
+            if (static_cast<std::uint64_t>(monotonicTime() - start) >= MinimumTime || iterations >= (1ull << 32))
+            {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        double best = 0.0;
+        for (int repetition = 0; repetition < Repetitions; ++repetition)
+        {
+            std::int64_t start = monotonicTime();
+            for (std::uint64_t i = 0; i < iterations; ++i)
+            {
+                body(i);
+            }
+            double perOp = static_cast<double>(monotonicTime() - start) / iterations;
+            if (repetition == 0 || perOp < best)
+            {
+                best = perOp;
+            }
+        }
+
+        std::printf("{\"benchmark\":\"%s\",\"ns_per_op\":%.3f,\"iterations\":%llu}\n",
+            name, best, static_cast<unsigned long long>(iterations));
+        std::fflush(stdout);
+    }
+
+    /** Takes events like a backend without injecting them.
+     *
+     * Unlike NullBackend the events are kept alive, so building them
+     * is measured instead of optimized away.
+     */
+    struct SinkBackend
+    {
+        static std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                keep(events[i]);
+            }
+            return count;
+        }
+    };
+
+    /** Key type of the iteration, cycling through all of them */
+    inline KeyType keyTypeOf(std::uint64_t i)
+    {
+        return static_cast<KeyType>(i % KeyTypeCount);
+    }
+
+    inline MouseButton buttonOf(std::uint64_t i)
+    {
+        return static_cast<MouseButton>(i % MouseButtonCount);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    benchmark("translateKey", filter, [](std::uint64_t i) {
+        keep(translateKey(keyTypeOf(i)));
+    });
+
+    benchmark("Mouse::translateMouseButton", filter, [](std::uint64_t i) {
+        keep(Mouse::translateMouseButton(buttonOf(i)));
+    });
+
+    // warm the cache first, the benchmark measures the lookup
+    CreateKeyFromKeyType(Key_A);
+    benchmark("CreateKeyFromKeyType", filter, [](std::uint64_t i) {
+        keep(CreateKeyFromKeyType(keyTypeOf(i)));
+    });
+
+    benchmark("CreateKeyFromKeycode", filter, [](std::uint64_t i) {
+        keep(CreateKeyFromKeycode(0x20 + i % 0x5F)); // printable Latin-1
+    });
+
+    benchmark("resolveKeyFromKeyType", filter, [](std::uint64_t i) {
+        keep(resolveKeyFromKeyType(keyTypeOf(i)));
+    });
+
+    Key keys[64];
+    for (int k = 0; k < 64; ++k)
+    {
+        keys[k] = CreateKeyFromKeyType(keyTypeOf(k));
+    }
+    benchmark("Key copy", filter, [&keys](std::uint64_t i) {
+        Key copy = keys[i % 64];
+        keep(copy);
+    });
+
+    // event building of Keyboard without the system call
+    benchmark("Keyboard::pressKey SinkBackend", filter, [&keys](std::uint64_t i) {
+        Keyboard_base<SinkBackend>::pressKey(keys[i % 64]);
+    });
+
+    benchmark("Mouse::moveTo SinkBackend", filter, [](std::uint64_t i) {
+        Mouse_base<SinkBackend>::moveTo(static_cast<int>(i & 1023), 0);
+    });
+
+    // event building down to the stubbed system call
+    benchmark("Keyboard::pressKey", filter, [&keys](std::uint64_t i) {
+        Keyboard::pressKey(keys[i % 64]);
+    });
+
+    benchmark("Mouse::move", filter, [](std::uint64_t i) {
+        Mouse::move(i & 1 ? 1 : -1, 0);
+    });
+
+    InputBatch batch;
+    benchmark("InputBatch 64 keys", filter, [&keys, &batch](std::uint64_t) {
+        for (int k = 0; k < 64; ++k)
+        {
+            batch.pressKey(keys[k]);
+        }
+        batch.commit();
+    });
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_STUB_PLATFORM_HPP
+#define FI_STUB_PLATFORM_HPP
+
+#include "fakeinput/config.hpp"
+#ifndef UNIX
+#error "stub_platform.hpp replaces Xlib, build with -DUNIX"
+#endif
+
+/* Stand-ins for the Xlib and XTest functions the library calls, so the
+ * microbenchmarks link without libX11 and libXtst and run without an
+ * X server. Only the headers of Xlib and XTest are needed.
+ *
+ * The keyboard has keycodes 8 to 255, every key symbol maps to one of
+ * them. The stubs are kept out of line to cost a real library call.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+#if defined(__GNUC__)
+#define FI_STUB extern "C" __attribute__((noinline))
+#else
+#define FI_STUB extern "C"
+#endif
+
+namespace FakeInput
+{
+    namespace Stub
+    {
+        inline char display[256];
+        inline unsigned long requests = 0; // fake requests sent, read by nobody but keeps them alive
+    }
+}
+
+FI_STUB Display* XOpenDisplay(const char*)
+{
+    return reinterpret_cast<Display*>(FakeInput::Stub::display);
+}
+
+FI_STUB int XCloseDisplay(Display*)
+{
+    return 0;
+}
+
+FI_STUB int XFlush(Display*)
+{
+    return 1;
+}
+
+FI_STUB XIOErrorHandler XSetIOErrorHandler(XIOErrorHandler)
+{
+    return nullptr;
+}
+
+FI_STUB void XSetIOErrorExitHandler(Display*, XIOErrorExitHandler, void*)
+{
+}
+
+FI_STUB int XDisplayKeycodes(Display*, int* minKeycode, int* maxKeycode)
+{
+    *minKeycode = 8;
+    *maxKeycode = 255;
+    return 1;
+}
+
+FI_STUB int XRefreshKeyboardMapping(XMappingEvent*)
+{
+    return 1;
+}
+
+FI_STUB KeyCode XKeysymToKeycode(Display*, KeySym keysym)
+{
+    return keysym == NoSymbol ? 0 : static_cast<KeyCode>(8 + keysym % 248);
+}
+
+FI_STUB int XTestFakeKeyEvent(Display*, unsigned int, Bool, unsigned long)
+{
+    ++FakeInput::Stub::requests;
+    return 1;
+}
+
+FI_STUB int XTestFakeButtonEvent(Display*, unsigned int, Bool, unsigned long)
+{
+    ++FakeInput::Stub::requests;
+    return 1;
+}
+
+FI_STUB int XTestFakeMotionEvent(Display*, int, int, int, unsigned long)
+{
+    ++FakeInput::Stub::requests;
+    return 1;
+}
+
+FI_STUB int XTestFakeRelativeMotionEvent(Display*, int, int, unsigned long)
+{
+    ++FakeInput::Stub::requests;
+    return 1;
+}
+
+#undef FI_STUB
+
+#endif
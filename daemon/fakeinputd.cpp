@@ -0,0 +1,80 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* fakeinputd, injects input sent by clients over a Unix domain socket,
+ * see daemon_unix.hpp for the protocol.
+ *
+ * usage: fakeinputd [socket path]
+ *
+ * The socket defaults to $XDG_RUNTIME_DIR/fakeinputd.sock, or
+ * /tmp/fakeinputd-<uid>.sock without a runtime directory. Only the user
+ * running the daemon can connect to it.
+ */
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "fakeinput/daemon_unix.hpp"
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    if (argc > 1)
+    {
+        path = argv[1];
+    }
+    else if (const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR"))
+    {
+        path = std::string(runtimeDir) + "/fakeinputd.sock";
+    }
+    else
+    {
+        path = "/tmp/fakeinputd-" + std::to_string(geteuid()) + ".sock";
+    }
+
+    // server threads inherit the mask, the signals are taken below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    FakeInput::InjectionServer server;
+    if (!server.start(path))
+    {
+        return EXIT_FAILURE;
+    }
+    std::cerr << "fakeinputd listening on " << path << std::endl;
+
+    int signal;
+    sigwait(&signals, &signal);
+
+    server.stop();
+    std::cerr << "fakeinputd injected " << server.completedCount() << " requests" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_BACKEND_HPP
+#define FI_BACKEND_HPP
+
+#include "config.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "event.hpp"
+#include "inject.hpp"
+#include "state.hpp"
+
+namespace FakeInput
+{
+    /* Backends are the policy Keyboard_base, Mouse_base and InputBatch_base
+     * send their events through. A backend provides
+     *
+     *     static std::size_t submit(const InputEvent* events, std::size_t count);
+     *
+     * returning the number of events accepted. Everything is static, so
+     * the policy is resolved at compile time and costs no indirection.
+     * Backends which really press keys also pass the events to
+     * InputState_base<Backend>::track(), see state.hpp.
+     */
+
+    /** Sends events to the system, SendInput on Windows, XTest on Unix. */
+    struct SystemBackend
+    {
+        static std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            std::size_t sent = submitEvents(events, count);
+            InputState_base<SystemBackend>::track(events, count);
+            return sent;
+        }
+
+        /** Releases keys still held while the process exits, see InputState_base. */
+        static std::size_t submitAtExit(const InputEvent* events, std::size_t count)
+        {
+            return submitEventsAtExit(events, count);
+        }
+    };
+
+    /** Accepts and discards all events.
+     *
+     * Measures the library overhead alone, calls compile down to nothing.
+     */
+    struct NullBackend
+    {
+        static std::size_t submit(const InputEvent*, std::size_t count)
+        {
+            return count;
+        }
+    };
+
+    /** Keeps events in memory instead of injecting them.
+     *
+     * Every thread records into its own buffer, so tests can assert the
+     * exact event stream they produced without any desktop.
+     */
+    struct RecordingBackend
+    {
+        static std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            std::vector<InputEvent>& recorded = events_();
+            recorded.insert(recorded.end(), events, events + count);
+            InputState_base<RecordingBackend>::track(events, count);
+            return count;
+        }
+
+        /** Events submitted by the calling thread so far */
+        static const std::vector<InputEvent>& events()
+        {
+            return events_();
+        }
+
+        /** Forgets events of the calling thread. */
+        static void clear()
+        {
+            events_().clear();
+        }
+
+    private:
+        static std::vector<InputEvent>& events_()
+        {
+            static thread_local std::vector<InputEvent> recorded;
+            return recorded;
+        }
+    };
+
+    /** Whether the backend injects into the desktop whose keyboard layout is in use.
+     *
+     * Only then TextPlan_base reads the X keyboard mapping and binds
+     * missing characters to spare keycodes, which changes the keymap of
+     * the whole X server. Specialize it for backends of your own.
+     */
+    template<typename Backend_t>
+    struct UsesSystemLayout : std::false_type {};
+
+    template<>
+    struct UsesSystemLayout<SystemBackend> : std::true_type {};
+
+    using InputState = InputState_base<SystemBackend>;
+    using ReleaseGuard = ReleaseGuard_base<SystemBackend>;
+}
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_BATCH_HPP
+#define FI_BATCH_HPP
+
+#include "config.hpp"
+
+#include <cstddef>
+#include <vector>
+#include "backend.hpp"
+#include "event.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Collects input events and sends them to the system at once.
+     *
+     * All events are kept in one contiguous buffer and commit() submits them
+     * with a single SendInput call (Windows) or a single burst of XTest
+     * requests followed by one flush (Unix), instead of one system call
+     * per event. Delays added with wait() are paced by the X server on Unix.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class InputBatch_base
+    {
+    public:
+        InputBatch_base() = default;
+
+        /** Creates batch with preallocated space.
+         *
+         * @param capacity
+         *      Number of events to reserve space for.
+         */
+        explicit InputBatch_base(std::size_t capacity)
+        {
+            events_.reserve(capacity);
+        }
+
+        InputBatch_base& pressKey(Key key)
+        {
+            return addKeyEvent_(key, Event_KeyPress);
+        }
+
+        InputBatch_base& releaseKey(Key key)
+        {
+            return addKeyEvent_(key, Event_KeyRelease);
+        }
+
+        InputBatch_base& pressButton(MouseButton button)
+        {
+            return addButtonEvent_(button, Event_ButtonPress);
+        }
+
+        InputBatch_base& releaseButton(MouseButton button)
+        {
+            return addButtonEvent_(button, Event_ButtonRelease);
+        }
+
+        InputBatch_base& move(int dx, int dy)
+        {
+            return addPointerEvent_(Event_Move, dx, dy);
+        }
+
+        InputBatch_base& moveTo(int x, int y)
+        {
+            return addPointerEvent_(Event_MoveTo, x, y);
+        }
+
+        InputBatch_base& wheelUp()
+        {
+            return addPointerEvent_(Event_Wheel, 0, 1);
+        }
+
+        InputBatch_base& wheelDown()
+        {
+            return addPointerEvent_(Event_Wheel, 0, -1);
+        }
+
+        /** Delays the next added event.
+         *
+         * On Unix the delay is carried to the X server inside the event,
+         * so a timed sequence still goes out with a single flush and is
+         * paced by the server. A wait at the end of the batch is dropped.
+         *
+         * @param milisec
+         *      time to wait in miliseconds
+         */
+        InputBatch_base& wait(unsigned int milisec)
+        {
+            pendingDelay_ += milisec;
+            return *this;
+        }
+
+        /** Appends already prepared event. */
+        InputBatch_base& add(const InputEvent& event)
+        {
+            events_.push_back(event);
+            events_.back().delay += pendingDelay_;
+            pendingDelay_ = 0;
+            return *this;
+        }
+
+        const std::vector<InputEvent>& events() const
+        {
+            return events_;
+        }
+
+        std::size_t size() const
+        {
+            return events_.size();
+        }
+
+        bool empty() const
+        {
+            return events_.empty();
+        }
+
+        /** Removes all events, keeps the allocated buffer. */
+        void clear()
+        {
+            events_.clear();
+            pendingDelay_ = 0;
+        }
+
+        /** Sends all collected events to the system and clears the batch.
+         *
+         * @returns number of events the system accepted.
+         */
+        std::size_t commit()
+        {
+            std::size_t sent = Backend_t::submit(events_.data(), events_.size());
+            clear();
+            return sent;
+        }
+
+    private:
+        InputBatch_base& addKeyEvent_(Key key, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.key = key;
+            return add(event);
+        }
+
+        InputBatch_base& addButtonEvent_(MouseButton button, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.button = button;
+            return add(event);
+        }
+
+        InputBatch_base& addPointerEvent_(EventType type, int x, int y)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.x = x;
+            event.y = y;
+            return add(event);
+        }
+
+        std::vector<InputEvent> events_;
+        unsigned int pendingDelay_ = 0;
+    };
+
+    using InputBatch = InputBatch_base<SystemBackend>;
+}
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_COALESCER_HPP
+#define FI_COALESCER_HPP
+
+#include "config.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
+#include "system.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Merges relative mouse moves before they reach the system.
+     *
+     * Moves are accumulated and sent as one move when the time window
+     * since the first pending move has elapsed, so high rate motion is
+     * sent at most once per window. Deltas may be fractional, only the
+     * whole pixels are sent and the remainder is kept for the next move.
+     * Pending motion is always sent right before any other event, so the
+     * order of events is preserved.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class MotionCoalescer_base
+    {
+    public:
+        /** Default window, one frame of a 240 Hz display, in nanoseconds */
+        static constexpr std::int64_t DefaultWindow = 1000000000 / 240;
+
+        /** Creates coalescer.
+         *
+         * @param window
+         *      Nanoseconds to accumulate moves for, 0 sends every whole pixel at once.
+         */
+        explicit MotionCoalescer_base(std::int64_t window = DefaultWindow)
+            : window_(window)
+        {
+        }
+
+        /** Sends pending motion. */
+        ~MotionCoalescer_base()
+        {
+            flush();
+        }
+
+        MotionCoalescer_base(const MotionCoalescer_base&) = delete;
+        MotionCoalescer_base& operator=(const MotionCoalescer_base&) = delete;
+
+        /** Adds relative move, sends the accumulated motion if the window elapsed. */
+        void move(double dx, double dy)
+        {
+            std::int64_t now = monotonicTime();
+            if (!pending_)
+            {
+                pending_ = true;
+                windowStart_ = now;
+            }
+
+            dx_ += dx;
+            dy_ += dy;
+
+            if (now - windowStart_ >= window_)
+            {
+                flush();
+            }
+        }
+
+        /** Sends the accumulated motion if the window elapsed.
+         *
+         * Call it periodically when moves may stop arriving.
+         */
+        void poll()
+        {
+            if (pending_ && monotonicTime() - windowStart_ >= window_)
+            {
+                flush();
+            }
+        }
+
+        /** Sends the whole pixels of the accumulated motion now.
+         *
+         * @returns whether any motion was sent.
+         */
+        bool flush()
+        {
+            InputEvent motion{};
+            if (!takeMotion_(motion))
+            {
+                return false;
+            }
+
+            Backend_t::submit(&motion, 1);
+            return true;
+        }
+
+        void moveTo(int x, int y)
+        {
+            // absolute position makes accumulated motion and remainder meaningless
+            discard();
+            send_(pointerEvent_(Event_MoveTo, x, y));
+        }
+
+        void pressButton(MouseButton button)
+        {
+            send_(buttonEvent_(button, Event_ButtonPress));
+        }
+
+        void releaseButton(MouseButton button)
+        {
+            send_(buttonEvent_(button, Event_ButtonRelease));
+        }
+
+        void wheelUp()
+        {
+            send_(pointerEvent_(Event_Wheel, 0, 1));
+        }
+
+        void wheelDown()
+        {
+            send_(pointerEvent_(Event_Wheel, 0, -1));
+        }
+
+        void pressKey(Key key)
+        {
+            send_(keyEvent_(key, Event_KeyPress));
+        }
+
+        void releaseKey(Key key)
+        {
+            send_(keyEvent_(key, Event_KeyRelease));
+        }
+
+        /** Drops pending motion and the sub-pixel remainder. */
+        void discard()
+        {
+            dx_ = 0;
+            dy_ = 0;
+            pending_ = false;
+        }
+
+        /** Accumulated horizontal motion not sent yet, including the remainder */
+        double pendingX() const
+        {
+            return dx_;
+        }
+
+        /** Accumulated vertical motion not sent yet, including the remainder */
+        double pendingY() const
+        {
+            return dy_;
+        }
+
+    private:
+        /** Moves whole pixels of the accumulated motion into the event. */
+        bool takeMotion_(InputEvent& motion)
+        {
+            pending_ = false;
+
+            int dx = static_cast<int>(dx_); // truncates toward zero
+            int dy = static_cast<int>(dy_);
+            if (dx == 0 && dy == 0)
+            {
+                return false;
+            }
+
+            dx_ -= dx;
+            dy_ -= dy;
+
+            motion = pointerEvent_(Event_Move, dx, dy);
+            return true;
+        }
+
+        /** Sends pending motion followed by the event with one submission. */
+        void send_(const InputEvent& event)
+        {
+            InputEvent events[2];
+            std::size_t count = 0;
+            if (takeMotion_(events[0]))
+            {
+                ++count;
+            }
+            events[count++] = event;
+
+            Backend_t::submit(events, count);
+        }
+
+        static InputEvent keyEvent_(Key key, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.key = key;
+            return event;
+        }
+
+        static InputEvent buttonEvent_(MouseButton button, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.button = button;
+            return event;
+        }
+
+        static InputEvent pointerEvent_(EventType type, int x, int y)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.x = x;
+            event.y = y;
+            return event;
+        }
+
+        std::int64_t window_;
+        std::int64_t windowStart_ = 0;
+        double dx_ = 0;
+        double dy_ = 0;
+        bool pending_ = false;
+    };
+
+    using MotionCoalescer = MotionCoalescer_base<SystemBackend>;
+}
+
+#endif
@@ -24,15 +24,26 @@
 
 #ifndef WC_CONFIG_HPP
 #define WC_CONFIG_HPP
-#include <string>
+#include <cstdint>
+#include <type_traits>
 
-// Key base type
-template<typename Vk_t = unsigned, typename Scan_t = unsigned>
+// Key flags
+enum KeyFlags : std::uint8_t
+{
+    KeyFlag_None = 0,
+    KeyFlag_Extended = 1 << 0, // scancode needs the extended (E0) prefix
+    KeyFlag_VirtualKeyOnly = 1 << 1, // key has no usable scancode, send the virtual key
+    KeyFlag_Remapped = 1 << 2 // keycode is borrowed from KeycodePool (X11)
+};
+
+// Key base type, trivially copyable handle without any name,
+// use keyName() to look the name up
+template<typename Vk_t = std::uint16_t, typename Scan_t = std::uint16_t>
 struct Key_base
 {
-    Scan_t code_{}; // hardware scancode
     Vk_t virtualKey_{}; // virtual keycode
-    std::string name_{ "<no key>" };
+    Scan_t code_{}; // hardware scancode
+    std::uint8_t flags_{}; // KeyFlags
 };
 
 //#ifndef UNIX
@@ -42,13 +53,27 @@ struct Key_base
 // using Key = Key_base<KeySym, unsigned>;
 //#endif
 
-// Define platform macros manually since CMake is not being used
-#ifndef WIN32
+// Define platform macros manually since CMake is not being used,
+// pass -DUNIX to build for Unix-like platforms
+#if !defined(WIN32) && !defined(UNIX)
 #define WIN32
 #endif
 
+// Uncomment to collect injection counters and latency histograms, see metrics.hpp
+//#define FAKEINPUT_METRICS
+
+// Uncomment to record a timeline of the injection path, see trace.hpp
+//#define FAKEINPUT_TRACE
+
 #ifdef WIN32
 using Key = Key_base<>;
 #endif
 
+#ifdef UNIX
+using Key = Key_base<std::uint32_t, std::uint8_t>; // virtual key is KeySym, code is X keycode
+#endif
+
+static_assert(std::is_trivially_copyable<Key>::value && sizeof(Key) <= 8,
+    "Key must stay a small trivially copyable handle");
+
 #endif
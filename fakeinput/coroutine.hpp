@@ -0,0 +1,587 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_COROUTINE_HPP
+#define FI_COROUTINE_HPP
+
+#include "config.hpp"
+
+#if !defined(__cpp_impl_coroutine)
+#error "coroutine.hpp needs C++20 coroutines"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "backend.hpp"
+#include "event.hpp"
+#include "system.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Coroutine of an input sequence, run by InputLoop_base.
+     *
+     * The body starts when the task is spawned into a loop, e.g.
+     *
+     *     InputTask typeHello(InputLoop& loop)
+     *     {
+     *         co_await loop.keyboard.tap(CreateKeyFromKeyType(Key_H));
+     *         co_await loop.after(std::chrono::milliseconds(5));
+     *         co_await loop.keyboard.tap(CreateKeyFromKeyType(Key_I));
+     *     }
+     *
+     *     loop.spawn(typeHello(loop));
+     *     loop.run();
+     */
+    class InputTask
+    {
+    public:
+        struct promise_type
+        {
+            std::exception_ptr exception;
+
+            InputTask get_return_object()
+            {
+                return InputTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void()
+            {
+            }
+
+            void unhandled_exception()
+            {
+                exception = std::current_exception();
+            }
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        InputTask(InputTask&& other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr))
+        {
+        }
+
+        InputTask& operator=(InputTask&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                {
+                    handle_.destroy();
+                }
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+
+        InputTask(const InputTask&) = delete;
+        InputTask& operator=(const InputTask&) = delete;
+
+        /** Destroys the coroutine unless it was spawned. */
+        ~InputTask()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        /** Gives up ownership of the coroutine. */
+        Handle release()
+        {
+            return std::exchange(handle_, nullptr);
+        }
+
+    private:
+        explicit InputTask(Handle handle)
+            : handle_(handle)
+        {
+        }
+
+        Handle handle_;
+    };
+
+    /** Runs input sequences as coroutines on one thread.
+     *
+     * Sequences wait on a timer wheel instead of sleeping, so any number
+     * of them share the thread calling run() and need no thread or stack
+     * of their own. Input awaited by sequences which are resumed in the
+     * same pass is submitted with one backend call, then they continue.
+     *
+     * Timers are kept in a wheel of Slots_ slots, one per resolution
+     * interval, so scheduling is constant time. Due timers are collected
+     * in every pass, and only when nothing is ready the loop sleeps with
+     * sleepUntil() to the earliest deadline, timers fire at their exact
+     * deadline rather than at a tick boundary.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class InputLoop_base
+    {
+    public:
+        /** Awaitable submitting up to two events, resumes after the submission */
+        class InputAwaiter
+        {
+        public:
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                loop_->pending_.insert(loop_->pending_.end(), events_, events_ + count_);
+                loop_->submitted_.push_back(handle);
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+
+        private:
+            friend class InputLoop_base;
+
+            InputLoop_base* loop_;
+            InputEvent events_[2];
+            std::size_t count_;
+        };
+
+        /** Awaitable resuming at a deadline */
+        class TimerAwaiter
+        {
+        public:
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                loop_->schedule_(deadline_, handle);
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+
+        private:
+            friend class InputLoop_base;
+
+            InputLoop_base* loop_;
+            std::int64_t deadline_;
+        };
+
+        /** Keyboard input of the loop's sequences */
+        class KeyboardInput
+        {
+        public:
+            InputAwaiter press(Key key)
+            {
+                return loop_->awaitKey_(key, Event_KeyPress, false);
+            }
+
+            InputAwaiter release(Key key)
+            {
+                return loop_->awaitKey_(key, Event_KeyRelease, false);
+            }
+
+            /** Presses and releases the key in one submission. */
+            InputAwaiter tap(Key key)
+            {
+                return loop_->awaitKey_(key, Event_KeyPress, true);
+            }
+
+        private:
+            friend class InputLoop_base;
+
+            explicit KeyboardInput(InputLoop_base* loop)
+                : loop_(loop)
+            {
+            }
+
+            InputLoop_base* loop_;
+        };
+
+        /** Mouse input of the loop's sequences */
+        class MouseInput
+        {
+        public:
+            InputAwaiter press(MouseButton button)
+            {
+                return loop_->awaitButton_(button, Event_ButtonPress, false);
+            }
+
+            InputAwaiter release(MouseButton button)
+            {
+                return loop_->awaitButton_(button, Event_ButtonRelease, false);
+            }
+
+            /** Presses and releases the button in one submission. */
+            InputAwaiter click(MouseButton button)
+            {
+                return loop_->awaitButton_(button, Event_ButtonPress, true);
+            }
+
+            InputAwaiter move(int dx, int dy)
+            {
+                return loop_->awaitPointer_(Event_Move, dx, dy);
+            }
+
+            InputAwaiter moveTo(int x, int y)
+            {
+                return loop_->awaitPointer_(Event_MoveTo, x, y);
+            }
+
+            InputAwaiter wheelUp()
+            {
+                return loop_->awaitPointer_(Event_Wheel, 0, 1);
+            }
+
+            InputAwaiter wheelDown()
+            {
+                return loop_->awaitPointer_(Event_Wheel, 0, -1);
+            }
+
+        private:
+            friend class InputLoop_base;
+
+            explicit MouseInput(InputLoop_base* loop)
+                : loop_(loop)
+            {
+            }
+
+            InputLoop_base* loop_;
+        };
+
+        /** Creates loop.
+         *
+         * @param resolution
+         *      Width of one timer wheel slot.
+         */
+        explicit InputLoop_base(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1))
+            : keyboard(this), mouse(this), resolution_(resolution.count() > 0 ? resolution.count() : 1)
+        {
+            currentTick_ = monotonicTime() / resolution_;
+        }
+
+        InputLoop_base(const InputLoop_base&) = delete;
+        InputLoop_base& operator=(const InputLoop_base&) = delete;
+
+        /** Destroys sequences which have not finished. */
+        ~InputLoop_base()
+        {
+            for (std::coroutine_handle<> handle : ready_)
+            {
+                handle.destroy();
+            }
+            for (std::coroutine_handle<> handle : submitted_)
+            {
+                handle.destroy();
+            }
+            for (std::vector<Timer_>& slot : wheel_)
+            {
+                for (const Timer_& timer : slot)
+                {
+                    timer.handle.destroy();
+                }
+            }
+        }
+
+        /** Adds sequence, it starts in the next pass of run(). */
+        void spawn(InputTask task)
+        {
+            InputTask::Handle handle = task.release();
+            if (handle)
+            {
+                ++liveCount_;
+                ready_.push_back(handle);
+            }
+        }
+
+        /** Resumes the awaiting sequence after the duration. */
+        TimerAwaiter after(std::chrono::nanoseconds duration)
+        {
+            return at(monotonicTime() + duration.count());
+        }
+
+        /** Resumes the awaiting sequence at the deadline.
+         *
+         * @param deadline
+         *      Absolute monotonicTime().
+         */
+        TimerAwaiter at(std::int64_t deadline)
+        {
+            TimerAwaiter awaiter;
+            awaiter.loop_ = this;
+            awaiter.deadline_ = deadline;
+            return awaiter;
+        }
+
+        /** Runs sequences until all of them finished or stop() was called.
+         *
+         * Exception of a sequence is rethrown here, after the sequence
+         * was destroyed.
+         */
+        void run()
+        {
+            isStopping_ = false;
+            while (liveCount_ > 0 && !isStopping_)
+            {
+                // due timers join every pass, busy sequences must not starve them
+                if (timerCount_ > 0)
+                {
+                    expireTimers_();
+                }
+
+                if (!ready_.empty())
+                {
+                    resumeReady_();
+                }
+                else if (!pending_.empty() || !submitted_.empty())
+                {
+                    submit_();
+                }
+                else if (timerCount_ > 0)
+                {
+                    sleepUntil(nextDeadline_());
+                }
+                else
+                {
+                    break; // sequences wait for something else than this loop
+                }
+            }
+        }
+
+        /** Makes run() return after the current pass, call it from a sequence. */
+        void stop()
+        {
+            isStopping_ = true;
+        }
+
+        /** Number of sequences which have not finished */
+        std::size_t size() const
+        {
+            return liveCount_;
+        }
+
+        KeyboardInput keyboard;
+        MouseInput mouse;
+
+    private:
+        /** Number of timer wheel slots */
+        static constexpr std::size_t Slots_ = 512;
+
+        struct Timer_
+        {
+            std::int64_t deadline;
+            std::coroutine_handle<> handle;
+        };
+
+        InputAwaiter awaitKey_(Key key, EventType type, bool withRelease)
+        {
+            InputAwaiter awaiter{};
+            awaiter.loop_ = this;
+            awaiter.events_[0].type = type;
+            awaiter.events_[0].key = key;
+            awaiter.events_[1] = awaiter.events_[0];
+            awaiter.events_[1].type = Event_KeyRelease;
+            awaiter.count_ = withRelease ? 2 : 1;
+            return awaiter;
+        }
+
+        InputAwaiter awaitButton_(MouseButton button, EventType type, bool withRelease)
+        {
+            InputAwaiter awaiter{};
+            awaiter.loop_ = this;
+            awaiter.events_[0].type = type;
+            awaiter.events_[0].button = button;
+            awaiter.events_[1] = awaiter.events_[0];
+            awaiter.events_[1].type = Event_ButtonRelease;
+            awaiter.count_ = withRelease ? 2 : 1;
+            return awaiter;
+        }
+
+        InputAwaiter awaitPointer_(EventType type, int x, int y)
+        {
+            InputAwaiter awaiter{};
+            awaiter.loop_ = this;
+            awaiter.events_[0].type = type;
+            awaiter.events_[0].x = x;
+            awaiter.events_[0].y = y;
+            awaiter.count_ = 1;
+            return awaiter;
+        }
+
+        void schedule_(std::int64_t deadline, std::coroutine_handle<> handle)
+        {
+            // past deadlines land in the current slot and fire in the next pass
+            std::int64_t tick = std::max(deadline / resolution_, currentTick_);
+            wheel_[static_cast<std::size_t>(tick) % Slots_].push_back(Timer_{ deadline, handle });
+            ++timerCount_;
+        }
+
+        /** Resumes the sequences ready so far, they may queue input or timers. */
+        void resumeReady_()
+        {
+            std::exception_ptr exception;
+
+            resuming_.swap(ready_);
+            for (std::coroutine_handle<> handle : resuming_)
+            {
+                handle.resume();
+                if (handle.done())
+                {
+                    std::exception_ptr failure = finish_(handle);
+                    if (failure && !exception)
+                    {
+                        exception = failure;
+                    }
+                }
+            }
+            resuming_.clear();
+
+            // other sequences of the pass were resumed, run() may be called again
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+
+        /** Submits input of all sequences resumed in the pass, then readies them. */
+        void submit_()
+        {
+            if (!pending_.empty())
+            {
+                Backend_t::submit(pending_.data(), pending_.size());
+                pending_.clear();
+            }
+            ready_.insert(ready_.end(), submitted_.begin(), submitted_.end());
+            submitted_.clear();
+        }
+
+        /** Earliest deadline, searching the wheel one revolution ahead */
+        std::int64_t nextDeadline_() const
+        {
+            for (std::size_t offset = 0; offset < Slots_; ++offset)
+            {
+                std::int64_t tick = currentTick_ + static_cast<std::int64_t>(offset);
+                const std::vector<Timer_>& slot = wheel_[static_cast<std::size_t>(tick) % Slots_];
+
+                bool isFound = false;
+                std::int64_t earliest = 0;
+                for (const Timer_& timer : slot)
+                {
+                    // entries of later revolutions share the slot
+                    if (timer.deadline / resolution_ <= tick && (!isFound || timer.deadline < earliest))
+                    {
+                        earliest = timer.deadline;
+                        isFound = true;
+                    }
+                }
+                if (isFound)
+                {
+                    return earliest;
+                }
+            }
+
+            return (currentTick_ + static_cast<std::int64_t>(Slots_)) * resolution_;
+        }
+
+        /** Moves due timers to the ready list and advances the wheel to now. */
+        void expireTimers_()
+        {
+            std::int64_t now = monotonicTime();
+            std::int64_t nowTick = now / resolution_;
+            std::int64_t lastTick = std::min(nowTick, currentTick_ + static_cast<std::int64_t>(Slots_) - 1);
+
+            for (std::int64_t tick = currentTick_; tick <= lastTick; ++tick)
+            {
+                std::vector<Timer_>& slot = wheel_[static_cast<std::size_t>(tick) % Slots_];
+                std::size_t kept = 0;
+                for (const Timer_& timer : slot)
+                {
+                    if (timer.deadline <= now)
+                    {
+                        ready_.push_back(timer.handle);
+                        --timerCount_;
+                    }
+                    else
+                    {
+                        slot[kept++] = timer;
+                    }
+                }
+                slot.resize(kept);
+            }
+
+            currentTick_ = nowTick;
+        }
+
+        /** Destroys finished sequence, @returns its exception. */
+        std::exception_ptr finish_(std::coroutine_handle<> handle)
+        {
+            --liveCount_;
+            auto task = InputTask::Handle::from_address(handle.address());
+            std::exception_ptr exception = task.promise().exception;
+            task.destroy();
+            return exception;
+        }
+
+        std::int64_t resolution_;
+        std::int64_t currentTick_;
+        std::vector<Timer_> wheel_[Slots_];
+        std::size_t timerCount_ = 0;
+
+        std::vector<std::coroutine_handle<>> ready_;
+        std::vector<std::coroutine_handle<>> resuming_;
+        std::vector<std::coroutine_handle<>> submitted_;
+        std::vector<InputEvent> pending_;
+
+        std::size_t liveCount_ = 0;
+        bool isStopping_ = false;
+    };
+
+    using InputLoop = InputLoop_base<SystemBackend>;
+}
+
+#endif
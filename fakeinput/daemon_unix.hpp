@@ -0,0 +1,653 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_DAEMON_UNIX_HPP
+#define FI_DAEMON_UNIX_HPP
+
+#include "config.hpp"
+#ifdef UNIX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend.hpp"
+#include "event.hpp"
+#include "system.hpp"
+#include "types.hpp"
+
+/* Socket protocol of InjectionServer, all integers little endian.
+ *
+ * Request, any number may be sent without waiting for completions:
+ *
+ *   u32 length      bytes following this field
+ *   u32 request id  chosen by the client, echoed in the completion
+ *   u32 count       number of events
+ *   count events of WireEventSize bytes:
+ *       u8 type, u8 button, u8 key flags, u8 reserved,
+ *       u32 virtual key, u32 key code, i32 x, i32 y, u32 delay (ms)
+ *
+ * Completion, sent when the request was injected, in request order:
+ *
+ *   u32 length      always CompletionSize - 4
+ *   u32 request id
+ *   u32 accepted    events the system accepted
+ *   i64 start       monotonic nanoseconds before the submission
+ *   i64 end         monotonic nanoseconds after the submission
+ *
+ * Requests queued together are submitted as one burst, start and end
+ * cover the whole burst, not only the events of the request.
+ *
+ * A malformed request closes the connection. The server stops reading
+ * a client while it has MaxClientEvents events queued or does not read
+ * its completions, so a fast client waits instead of filling memory.
+ */
+
+namespace FakeInput
+{
+    /** Size of one event in a request */
+    constexpr std::size_t WireEventSize = 24;
+
+    /** Size of a completion including its length field */
+    constexpr std::size_t CompletionSize = 28;
+
+    /** Largest number of events in one request */
+    constexpr std::uint32_t MaxWireEvents = 65536;
+
+    /** Events of one client queued for injection before the server stops reading it */
+    constexpr std::size_t MaxClientEvents = 4 * MaxWireEvents;
+
+    /** Encodes event into WireEventSize bytes. */
+    inline void encodeWireEvent(const InputEvent& event, std::uint8_t* out)
+    {
+        auto put32 = [](std::uint8_t* at, std::uint32_t value) {
+            for (int i = 0; i < 4; ++i)
+            {
+                at[i] = static_cast<std::uint8_t>(value >> (8 * i));
+            }
+        };
+
+        out[0] = static_cast<std::uint8_t>(event.type);
+        out[1] = static_cast<std::uint8_t>(event.button);
+        out[2] = event.key.flags_;
+        out[3] = 0;
+        put32(out + 4, event.key.virtualKey_);
+        put32(out + 8, event.key.code_);
+        put32(out + 12, static_cast<std::uint32_t>(event.x));
+        put32(out + 16, static_cast<std::uint32_t>(event.y));
+        put32(out + 20, event.delay);
+    }
+
+    /** Decodes event of WireEventSize bytes.
+     *
+     * @returns false if the event type or button is unknown.
+     */
+    inline bool decodeWireEvent(const std::uint8_t* in, InputEvent& event)
+    {
+        auto get32 = [](const std::uint8_t* at) {
+            return std::uint32_t(at[0]) | std::uint32_t(at[1]) << 8 | std::uint32_t(at[2]) << 16 | std::uint32_t(at[3]) << 24;
+        };
+
+        if (in[0] > Event_UnicodeRelease || in[1] >= MouseButtonCount)
+        {
+            return false;
+        }
+
+        event = InputEvent{};
+        event.type = static_cast<EventType>(in[0]);
+        event.button = static_cast<MouseButton>(in[1]);
+        event.key.flags_ = in[2];
+        event.key.virtualKey_ = static_cast<decltype(event.key.virtualKey_)>(get32(in + 4));
+        event.key.code_ = static_cast<decltype(event.key.code_)>(get32(in + 8));
+        event.x = static_cast<std::int32_t>(get32(in + 12));
+        event.y = static_cast<std::int32_t>(get32(in + 16));
+        event.delay = get32(in + 20);
+        return true;
+    }
+
+    /** Injects input for clients of a Unix domain socket.
+     *
+     * Clients send batches of events and may pipeline requests, every
+     * request gets a completion with the injection timestamps once it is
+     * submitted. An I/O thread reads and writes all connections, an
+     * injection thread takes all requests queued so far, submits their
+     * events with one backend call and sends the completions, so the
+     * events of all clients go out as one stream in arrival order.
+     *
+     * The socket is accessible to the owner only, and connections of
+     * other users are refused by their peer credentials.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     *
+     * @warning @image html tux.png
+     *    Unix-like platform only
+     */
+    template<typename Backend_t>
+    class InjectionServer_base
+    {
+    public:
+        InjectionServer_base() = default;
+
+        InjectionServer_base(const InjectionServer_base&) = delete;
+        InjectionServer_base& operator=(const InjectionServer_base&) = delete;
+
+        ~InjectionServer_base()
+        {
+            stop();
+        }
+
+        /** Listens on the socket path and starts serving.
+         *
+         * An existing socket file at the path is replaced, the new one
+         * gets mode 0600 before it takes connections.
+         *
+         * @returns false if the socket cannot be created.
+         */
+        bool start(const std::string& path)
+        {
+            if (isRunning_)
+            {
+                return false;
+            }
+
+            sockaddr_un address{};
+            if (path.size() >= sizeof(address.sun_path))
+            {
+                std::cerr << "Socket path is too long: " << path << std::endl;
+                return false;
+            }
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+            listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listener_ < 0 || pipe2(wakePipe_, O_NONBLOCK | O_CLOEXEC) != 0)
+            {
+                return fail_("create socket");
+            }
+
+            unlink(path.c_str());
+            // connections are refused until listen(), so nobody gets in before chmod()
+            if (bind(listener_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+                || chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listener_, 64) != 0)
+            {
+                unlink(path.c_str());
+                return fail_("listen on " + path);
+            }
+
+            path_ = path;
+            stopping_ = false;
+            isRunning_ = true;
+            ioThread_ = std::thread(&InjectionServer_base::serve_, this);
+            injectionThread_ = std::thread(&InjectionServer_base::inject_, this);
+            return true;
+        }
+
+        /** Injects what is queued, closes all connections and removes the socket. */
+        void stop()
+        {
+            if (!isRunning_)
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            queued_.notify_one();
+            injectionThread_.join();
+
+            wakeIo_();
+            ioThread_.join();
+
+            closeFd_(listener_);
+            closeFd_(wakePipe_[0]);
+            closeFd_(wakePipe_[1]);
+            unlink(path_.c_str());
+            isRunning_ = false;
+        }
+
+        bool isRunning() const
+        {
+            return isRunning_;
+        }
+
+        /** Number of requests injected so far. */
+        std::uint64_t completedCount() const
+        {
+            return completed_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /** Upper bound of events submitted with one call, requests are never split */
+        static constexpr std::size_t MaxBurst_ = 4096;
+
+        /** Input buffered per client, the largest request fits */
+        static constexpr std::size_t MaxInput_ = 12 + MaxWireEvents * WireEventSize;
+
+        /** Completions buffered per client before the server stops reading it */
+        static constexpr std::size_t MaxOutput_ = 1024 * CompletionSize;
+
+        struct Client_
+        {
+            int fd;
+            std::vector<std::uint8_t> input; // bytes of incomplete requests
+            std::mutex outputMutex;
+            std::vector<std::uint8_t> output; // completions not written yet
+            std::size_t queuedEvents = 0; // guarded by the server mutex
+            bool isClosed = false;
+        };
+
+        struct Request_
+        {
+            std::shared_ptr<Client_> client;
+            std::uint32_t id;
+            std::vector<InputEvent> events;
+        };
+
+        bool fail_(const std::string& action)
+        {
+            std::cerr << "Cannot " << action << ": " << std::strerror(errno) << std::endl;
+            closeFd_(listener_);
+            closeFd_(wakePipe_[0]);
+            closeFd_(wakePipe_[1]);
+            return false;
+        }
+
+        static void closeFd_(int& fd)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        void wakeIo_()
+        {
+            std::uint8_t byte = 0;
+            ssize_t written = ::write(wakePipe_[1], &byte, 1); // a full pipe wakes as well
+            (void)written;
+        }
+
+        /** Whether the client has room for more requests and reads its completions. */
+        bool acceptsInput_(Client_& client)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (client.queuedEvents >= MaxClientEvents)
+                {
+                    return false;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(client.outputMutex);
+            return client.output.size() < MaxOutput_;
+        }
+
+        /** Whether the peer runs as the user of this process. */
+        static bool isOwner_(int fd)
+        {
+            ucred credentials{};
+            socklen_t size = sizeof(credentials);
+            return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == geteuid();
+        }
+
+        /** I/O thread, accepts connections, reads requests and writes completions. */
+        void serve_()
+        {
+            std::vector<std::shared_ptr<Client_>> clients;
+            std::vector<bool> isReading; // per client, false while it is over its limits
+            std::vector<pollfd> fds;
+
+            for (;;)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (stopping_)
+                    {
+                        break;
+                    }
+                }
+
+                fds.clear();
+                fds.push_back(pollfd{ listener_, POLLIN, 0 });
+                fds.push_back(pollfd{ wakePipe_[0], POLLIN, 0 });
+                isReading.assign(clients.size(), false);
+                for (std::size_t i = 0; i < clients.size(); ++i)
+                {
+                    Client_& client = *clients[i];
+
+                    // requests buffered while the client was over its limits
+                    if (!client.input.empty() && acceptsInput_(client) && !parse_(clients[i]))
+                    {
+                        client.isClosed = true;
+                    }
+                    isReading[i] = !client.isClosed && acceptsInput_(client);
+
+                    std::lock_guard<std::mutex> lock(client.outputMutex);
+                    short events = (isReading[i] ? POLLIN : 0) | (client.output.empty() ? 0 : POLLOUT);
+                    // a client neither read nor written is left out, so its hangup is seen later
+                    fds.push_back(pollfd{ events != 0 && !client.isClosed ? client.fd : -1, events, 0 });
+                }
+
+                if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+                {
+                    std::cerr << "Cannot poll connections: " << std::strerror(errno) << std::endl;
+                    break;
+                }
+
+                if (fds[1].revents & POLLIN)
+                {
+                    std::uint8_t drain[64];
+                    while (::read(wakePipe_[0], drain, sizeof(drain)) > 0)
+                    {
+                    }
+                }
+
+                for (std::size_t i = 0; i < clients.size(); ++i)
+                {
+                    Client_& client = *clients[i];
+                    short revents = fds[i + 2].revents;
+
+                    if ((revents & POLLOUT) && !write_(client))
+                    {
+                        client.isClosed = true;
+                    }
+                    if ((revents & (POLLHUP | POLLERR)) && !isReading[i])
+                    {
+                        client.isClosed = true; // completions cannot be written anymore
+                    }
+                    if ((revents & (POLLIN | POLLHUP | POLLERR)) && isReading[i] && !client.isClosed && !read_(clients[i]))
+                    {
+                        client.isClosed = true;
+                    }
+                }
+
+                clients.erase(std::remove_if(clients.begin(), clients.end(), [](const std::shared_ptr<Client_>& client) {
+                    if (client->isClosed)
+                    {
+                        ::close(client->fd);
+                    }
+                    return client->isClosed;
+                }), clients.end());
+
+                if (fds[0].revents & POLLIN)
+                {
+                    int fd;
+                    while ((fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                    {
+                        if (!isOwner_(fd))
+                        {
+                            std::cerr << "Refused connection of another user" << std::endl;
+                            ::close(fd);
+                            continue;
+                        }
+
+                        auto client = std::make_shared<Client_>();
+                        client->fd = fd;
+                        clients.push_back(client);
+                    }
+                }
+            }
+
+            // completions of the last requests are written while the client listens
+            for (const auto& client : clients)
+            {
+                if (!client->isClosed)
+                {
+                    int flags = fcntl(client->fd, F_GETFL);
+                    fcntl(client->fd, F_SETFL, flags & ~O_NONBLOCK);
+                    write_(*client);
+                }
+                ::close(client->fd);
+            }
+        }
+
+        /** Reads available bytes up to MaxInput_ and queues complete requests, returns false to close. */
+        bool read_(const std::shared_ptr<Client_>& client)
+        {
+            std::uint8_t buffer[65536];
+            while (client->input.size() < MaxInput_)
+            {
+                std::size_t room = std::min(sizeof(buffer), MaxInput_ - client->input.size());
+                ssize_t received = ::read(client->fd, buffer, room);
+                if (received == 0)
+                {
+                    return false;
+                }
+                if (received < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    {
+                        return false;
+                    }
+                    break;
+                }
+                client->input.insert(client->input.end(), buffer, buffer + received);
+            }
+
+            return parse_(client);
+        }
+
+        /** Moves complete requests from the input buffer to the queue, until the client reaches MaxClientEvents. */
+        bool parse_(const std::shared_ptr<Client_>& client)
+        {
+            std::vector<std::uint8_t>& input = client->input;
+            std::size_t offset = 0;
+            bool isQueued = false;
+            bool isValid = true;
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (input.size() - offset >= 12)
+            {
+                const std::uint8_t* frame = input.data() + offset;
+                std::uint32_t length = get32_(frame);
+                std::uint32_t count = get32_(frame + 8);
+                if (count > MaxWireEvents || length != 8 + count * WireEventSize)
+                {
+                    isValid = false;
+                    break;
+                }
+                if (input.size() - offset < 4 + length)
+                {
+                    break; // rest of the request not received yet
+                }
+                if (client->queuedEvents > 0 && client->queuedEvents + count > MaxClientEvents)
+                {
+                    break; // parsed again once its queue drains
+                }
+
+                Request_ request{ client, get32_(frame + 4), std::vector<InputEvent>(count) };
+                for (std::uint32_t i = 0; i < count && isValid; ++i)
+                {
+                    isValid = decodeWireEvent(frame + 12 + i * WireEventSize, request.events[i]);
+                }
+                if (!isValid)
+                {
+                    break;
+                }
+
+                client->queuedEvents += count;
+                requests_.push_back(std::move(request));
+                offset += 4 + length;
+                isQueued = true;
+            }
+            lock.unlock();
+
+            input.erase(input.begin(), input.begin() + offset);
+            if (isQueued)
+            {
+                queued_.notify_one();
+            }
+            return isValid;
+        }
+
+        /** Writes pending completions, returns false to close. */
+        static bool write_(Client_& client)
+        {
+            std::lock_guard<std::mutex> lock(client.outputMutex);
+
+            std::size_t offset = 0;
+            while (offset < client.output.size())
+            {
+                ssize_t written = ::send(client.fd, client.output.data() + offset, client.output.size() - offset, MSG_NOSIGNAL);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        break;
+                    }
+                    return false;
+                }
+                offset += static_cast<std::size_t>(written);
+            }
+
+            client.output.erase(client.output.begin(), client.output.begin() + offset);
+            return true;
+        }
+
+        /** Injection thread, submits queued requests and produces completions. */
+        void inject_()
+        {
+            std::vector<InputEvent> burst;
+            std::vector<Request_> requests;
+
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    queued_.wait(lock, [this] { return !requests_.empty() || stopping_; });
+                    if (requests_.empty())
+                    {
+                        break;
+                    }
+
+                    // whole requests, as many as fit the burst, in arrival order
+                    burst.clear();
+                    requests.clear();
+                    while (!requests_.empty() && (requests.empty() || burst.size() + requests_.front().events.size() <= MaxBurst_))
+                    {
+                        Request_& request = requests_.front();
+                        burst.insert(burst.end(), request.events.begin(), request.events.end());
+                        request.client->queuedEvents -= request.events.size();
+                        requests.push_back(std::move(request));
+                        requests_.pop_front();
+                    }
+                }
+
+                std::int64_t start = monotonicTime();
+                std::size_t accepted = burst.empty() ? 0 : Backend_t::submit(burst.data(), burst.size());
+                std::int64_t end = monotonicTime();
+
+                // the system accepts a prefix of the burst, start and end are shared by all its requests
+                std::size_t offset = 0;
+                for (const Request_& request : requests)
+                {
+                    std::size_t count = request.events.size();
+                    std::size_t requestAccepted = accepted > offset ? std::min(accepted - offset, count) : 0;
+                    offset += count;
+                    complete_(*request.client, request.id, static_cast<std::uint32_t>(requestAccepted), start, end);
+                }
+                completed_.fetch_add(requests.size(), std::memory_order_relaxed);
+
+                wakeIo_();
+            }
+        }
+
+        static void complete_(Client_& client, std::uint32_t id, std::uint32_t accepted, std::int64_t start, std::int64_t end)
+        {
+            std::uint8_t completion[CompletionSize];
+            put32_(completion, CompletionSize - 4);
+            put32_(completion + 4, id);
+            put32_(completion + 8, accepted);
+            put32_(completion + 12, static_cast<std::uint32_t>(start));
+            put32_(completion + 16, static_cast<std::uint32_t>(static_cast<std::uint64_t>(start) >> 32));
+            put32_(completion + 20, static_cast<std::uint32_t>(end));
+            put32_(completion + 24, static_cast<std::uint32_t>(static_cast<std::uint64_t>(end) >> 32));
+
+            std::lock_guard<std::mutex> lock(client.outputMutex);
+            client.output.insert(client.output.end(), completion, completion + CompletionSize);
+        }
+
+        static std::uint32_t get32_(const std::uint8_t* at)
+        {
+            return std::uint32_t(at[0]) | std::uint32_t(at[1]) << 8 | std::uint32_t(at[2]) << 16 | std::uint32_t(at[3]) << 24;
+        }
+
+        static void put32_(std::uint8_t* at, std::uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                at[i] = static_cast<std::uint8_t>(value >> (8 * i));
+            }
+        }
+
+        std::string path_;
+        int listener_ = -1;
+        int wakePipe_[2] = { -1, -1 };
+        bool isRunning_ = false;
+
+        std::mutex mutex_;
+        std::condition_variable queued_;
+        std::deque<Request_> requests_;
+        bool stopping_ = false;
+        std::atomic<std::uint64_t> completed_{ 0 };
+
+        std::thread ioThread_;
+        std::thread injectionThread_;
+    };
+
+    using InjectionServer = InjectionServer_base<SystemBackend>;
+}
+
+#endif
+#endif
@@ -29,19 +29,274 @@
 #ifdef UNIX
 #include <X11/Xlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "metrics.hpp"
+
 namespace FakeInput
 {
-    /** Get connection to the X server
+    /** Owner of long-lived connections to X servers.
+     *
+     * Every thread gets its own connection to each display it talks to,
+     * so Xlib is never used concurrently from several threads and no
+     * locking is needed on the injection path. Connections are opened
+     * on first use and kept until the thread exits or they are closed
+     * explicitly. A failed open is retried on the next request.
+     *
+     * A connection the server drops does not exit the process, as Xlib
+     * does by default. The calls on it fail and the next get() opens a
+     * new one. This needs Xlib 1.7 or newer for XSetIOErrorExitHandler.
      *
      * @warning @image html tux.png
      *    Unix-like platform only
      */
-    Display* display()
+    class DisplayConnection
     {
-        static Display* display = XOpenDisplay(0);
-        return display;
+    public:
+        /** Gets connection of the calling thread to the X server.
+         *
+         * @param name
+         *     Display name (e.g. ":1"), null for the DISPLAY variable.
+         *
+         * @returns connection or null if the server is unreachable.
+         */
+        static Display* get(const char* name = nullptr)
+        {
+            ThreadConnections_& connections = threadConnections_();
+
+            Entry_& entry = connections.find(name);
+            if (entry.isLost)
+            {
+                close_(entry.display);
+            }
+            if (!entry.display)
+            {
+                open_(entry, name);
+            }
+
+            return entry.display;
+        }
+
+        /** Closes the calling thread's connection and opens a new one.
+         *
+         * @param name
+         *     Display name, null for the DISPLAY variable.
+         *
+         * @returns new connection or null if the server is unreachable.
+         */
+        static Display* reconnect(const char* name = nullptr)
+        {
+            Entry_& entry = threadConnections_().find(name);
+            close_(entry.display);
+            open_(entry, name);
+
+            return entry.display;
+        }
+
+        /** Closes all connections of the calling thread. */
+        static void closeThread()
+        {
+            for (Entry_& entry : threadConnections_().entries)
+            {
+                close_(entry.display);
+            }
+        }
+
+        /** Closes connections of all threads.
+         *
+         * Must not run concurrently with injection on other threads,
+         * connections are reopened on their next use.
+         */
+        static void shutdown()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_());
+            for (ThreadConnections_* connections : registry_())
+            {
+                for (Entry_& entry : connections->entries)
+                {
+                    closeLocked_(entry.display);
+                }
+            }
+        }
+
+        /** Number of connections opened again after being lost or closed. */
+        static unsigned long reconnectCount()
+        {
+            return reconnects_().load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Entry_
+        {
+            std::string name;
+            bool isDefault;
+            bool wasOpened;
+            bool isLost; // the server dropped the connection
+            Display* display;
+        };
+
+        struct ThreadConnections_
+        {
+            ThreadConnections_()
+            {
+                std::lock_guard<std::mutex> lock(registryMutex_());
+                registry_().push_back(this);
+            }
+
+            ~ThreadConnections_()
+            {
+                std::lock_guard<std::mutex> lock(registryMutex_());
+                for (Entry_& entry : entries)
+                {
+                    closeLocked_(entry.display);
+                }
+
+                auto& registry = registry_();
+                registry.erase(std::remove(registry.begin(), registry.end(), this), registry.end());
+            }
+
+            Entry_& find(const char* name)
+            {
+                for (Entry_& entry : entries)
+                {
+                    if (name ? !entry.isDefault && entry.name == name : entry.isDefault)
+                    {
+                        return entry;
+                    }
+                }
+
+                entries.push_back(Entry_{ name ? name : "", name == nullptr, false, false, nullptr });
+                return entries.back();
+            }
+
+            std::deque<Entry_> entries; // stable addresses, the I/O error handler keeps them
+        };
+
+        static ThreadConnections_& threadConnections_()
+        {
+            static thread_local ThreadConnections_ connections;
+            return connections;
+        }
+
+        static void open_(Entry_& entry, const char* name)
+        {
+            static std::once_flag handlerInstalled;
+            std::call_once(handlerInstalled, [] {
+                previousIOErrorHandler_() = XSetIOErrorHandler(&DisplayConnection::ioError_);
+            });
+
+            // a slow or hung server must not hold up other threads' connections
+            Display* display = XOpenDisplay(name);
+            if (display)
+            {
+                XSetIOErrorExitHandler(display, &DisplayConnection::ioErrorExit_, &entry);
+            }
+
+            std::lock_guard<std::mutex> lock(registryMutex_());
+            entry.display = display;
+            entry.isLost = false;
+            if (display)
+            {
+                if (entry.wasOpened)
+                {
+                    reconnects_().fetch_add(1, std::memory_order_relaxed);
+                    Metrics::count(Metric_Reconnects);
+                }
+                entry.wasOpened = true;
+            }
+        }
+
+        /** Reports lost connection, forwards those not owned here to the previous handler. */
+        static int ioError_(Display* display)
+        {
+            // the error is raised on the thread using the connection
+            for (const Entry_& entry : threadConnections_().entries)
+            {
+                if (entry.display == display)
+                {
+                    std::cerr << "Lost connection to X server " << DisplayString(display) << ", reconnecting" << std::endl;
+                    return 0;
+                }
+            }
+
+            XIOErrorHandler previous = previousIOErrorHandler_();
+            return previous ? previous(display) : 0;
+        }
+
+        /** Replaces exit() of Xlib for owned connections, marks them for reopening */
+        static void ioErrorExit_(Display*, void* entry)
+        {
+            static_cast<Entry_*>(entry)->isLost = true;
+        }
+
+        static XIOErrorHandler& previousIOErrorHandler_()
+        {
+            static XIOErrorHandler handler = nullptr;
+            return handler;
+        }
+
+        static void close_(Display*& display)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_());
+            closeLocked_(display);
+        }
+
+        static void closeLocked_(Display*& display)
+        {
+            if (display)
+            {
+                XCloseDisplay(display);
+                display = nullptr;
+            }
+        }
+
+        static std::mutex& registryMutex_()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::vector<ThreadConnections_*>& registry_()
+        {
+            static std::vector<ThreadConnections_*> registry;
+            return registry;
+        }
+
+        static std::atomic<unsigned long>& reconnects_()
+        {
+            static std::atomic<unsigned long> reconnects{ 0 };
+            return reconnects;
+        }
+    };
+
+    /** Get connection of the calling thread to the X server
+     *
+     * @warning @image html tux.png
+     *    Unix-like platform only
+     */
+    inline Display* display()
+    {
+        return DisplayConnection::get();
+    }
+
+    /** Get connection of the calling thread to the given X server
+     *
+     * @param name
+     *     Display name, e.g. ":1"
+     *
+     * @warning @image html tux.png
+     *    Unix-like platform only
+     */
+    inline Display* display(const char* name)
+    {
+        return DisplayConnection::get(name);
     }
 }
 
 #endif
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,64 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_EVENT_HPP
+#define FI_EVENT_HPP
+
+#include "config.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Kind of input event carried by InputEvent */
+    enum EventType {
+        Event_None,
+        Event_KeyPress,
+        Event_KeyRelease,
+        Event_ButtonPress,
+        Event_ButtonRelease,
+        Event_Move,
+        Event_MoveTo,
+        Event_Wheel,
+        Event_MoveToNormalized, // absolute move in 0-65535 virtual desktop coordinates
+        Event_UnicodePress, // UTF-16 code unit in x, Windows only
+        Event_UnicodeRelease
+    };
+
+    /** Platform independent description of a single input event.
+     *
+     * Events are collected by InputBatch and translated to the native
+     * representation only when they are submitted to the system.
+     */
+    struct InputEvent
+    {
+        EventType type{ Event_None };
+        Key key{}; // key to press or release
+        MouseButton button{ Mouse_Left }; // button to press or release
+        int x{}; // relative dx, virtual desktop x, normalized x or UTF-16 code unit
+        int y{}; // relative dy, absolute y or wheel steps (positive is up)
+        unsigned delay{}; // miliseconds to wait after the previous event of the same submission
+    };
+}
+
+#endif
@@ -24,6 +24,7 @@
 
 // include core
 #include "fakeinput/config.hpp"
+#include "fakeinput/batch.hpp"
 #include "fakeinput/keyboard.hpp"
 #include "fakeinput/mouse.hpp"
 #include "fakeinput/system.hpp"
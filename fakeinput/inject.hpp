@@ -0,0 +1,390 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_INJECT_HPP
+#define FI_INJECT_HPP
+
+#include "config.hpp"
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+#ifdef UNIX
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+#include "display_unix.hpp"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "event.hpp"
+#include "metrics.hpp"
+#include "screen.hpp"
+#include "system.hpp"
+#include "trace.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+#ifdef WIN32
+    /** Button-down flags of SendInput, indexed by MouseButton */
+    constexpr TranslationEntry<MouseButton, DWORD> mouseButtonTable[] =
+    {
+        { MouseButton::Mouse_Left, MOUSEEVENTF_LEFTDOWN },
+        { MouseButton::Mouse_Middle, MOUSEEVENTF_MIDDLEDOWN },
+        { MouseButton::Mouse_Right, MOUSEEVENTF_RIGHTDOWN }
+    };
+
+    static_assert(coversAllValues(mouseButtonTable, MouseButtonCount),
+        "mouseButtonTable must map every MouseButton, in declaration order");
+
+    /** Translates mouse button to the button-down flag of SendInput.
+     *
+     * The matching button-up flag is the returned value shifted left by one.
+     */
+    constexpr DWORD translateMouseButton(MouseButton button)
+    {
+        return button >= 0 && button < MouseButtonCount ? mouseButtonTable[button].code : 0;
+    }
+
+    /** Translates event to the INPUT structure accepted by SendInput.
+     *
+     * @param event
+     *      Event to translate, must not be a <no key> key event.
+     */
+    inline INPUT toNativeInput(const InputEvent& event)
+    {
+        INPUT input{};
+
+        switch (event.type)
+        {
+        case Event_KeyPress:
+        case Event_KeyRelease:
+            input.type = INPUT_KEYBOARD;
+
+            // Fallback logic: use scan code if valid, otherwise use virtual key
+            if (event.key.code_ != 0 && !(event.key.flags_ & KeyFlag_VirtualKeyOnly)) {
+                input.ki.wScan = event.key.code_;
+                input.ki.dwFlags = KEYEVENTF_SCANCODE;
+                if (event.key.flags_ & KeyFlag_Extended) {
+                    input.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+                }
+            }
+            else {
+                input.ki.wVk = event.key.virtualKey_;
+                input.ki.dwFlags = 0; // fallback to virtual key
+            }
+
+            if (event.type == Event_KeyRelease) {
+                input.ki.dwFlags |= KEYEVENTF_KEYUP;
+            }
+            break;
+        case Event_ButtonPress:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = translateMouseButton(event.button);  // e.g., MOUSEEVENTF_LEFTDOWN
+            break;
+        case Event_ButtonRelease:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = translateMouseButton(event.button) << 1;  // e.g., MOUSEEVENTF_LEFTUP
+            break;
+        case Event_Move:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = MOUSEEVENTF_MOVE;
+            input.mi.dx = event.x;
+            input.mi.dy = event.y;
+            break;
+        case Event_MoveTo:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+
+            // Normalize to 0-65535 over the whole virtual desktop
+            input.mi.dx = ScreenGeometry::normalizeX(event.x);
+            input.mi.dy = ScreenGeometry::normalizeY(event.y);
+            break;
+        case Event_MoveToNormalized:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+            input.mi.dx = event.x;
+            input.mi.dy = event.y;
+            break;
+        case Event_Wheel:
+            input.type = INPUT_MOUSE;
+            input.mi.dwFlags = MOUSEEVENTF_WHEEL;
+            input.mi.mouseData = static_cast<DWORD>(event.y * WHEEL_DELTA);
+            break;
+        case Event_UnicodePress:
+        case Event_UnicodeRelease:
+            input.type = INPUT_KEYBOARD;
+            input.ki.wScan = static_cast<WORD>(event.x);
+            input.ki.dwFlags = KEYEVENTF_UNICODE;
+            if (event.type == Event_UnicodeRelease) {
+                input.ki.dwFlags |= KEYEVENTF_KEYUP;
+            }
+            break;
+        case Event_None:
+            break;
+        }
+
+        return input;
+    }
+
+    /** Calls SendInput and records it in Metrics.
+     *
+     * @returns number of inputs the system accepted.
+     */
+    inline std::size_t sendInputs(std::vector<INPUT>& inputs)
+    {
+        UINT accepted;
+        {
+            TraceSpan span(Trace_Flush, static_cast<std::int64_t>(inputs.size()));
+            MetricsTimer timer(Metric_SubmitDuration);
+            accepted = ::SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+        }
+
+        Metrics::count(Metric_Flushes);
+        Metrics::count(Metric_EventsSubmitted, inputs.size());
+        Metrics::count(Metric_EventsRejected, inputs.size() - accepted);
+        return accepted;
+    }
+
+    /** Sends events to the system with a single SendInput call.
+     *
+     * Key events of <no key> are skipped. Windows has no server side
+     * pacing, so events with a delay split the submission: events before
+     * them are sent, the delay is waited out and sending continues.
+     *
+     * @param events
+     *      Pointer to the first event.
+     * @param count
+     *      Number of events to send.
+     *
+     * @returns number of events the system accepted.
+     */
+    inline std::size_t submitEvents(const InputEvent* events, std::size_t count)
+    {
+        TraceSpan span(Trace_Submit, static_cast<std::int64_t>(count));
+
+        static thread_local std::vector<INPUT> inputs;
+        inputs.clear();
+
+        std::size_t sent = 0;
+        unsigned delay = 0; // delays of skipped events carry over to the next one
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const InputEvent& event = events[i];
+            delay += event.delay;
+
+            if (event.type == Event_None) {
+                continue;
+            }
+            if ((event.type == Event_KeyPress || event.type == Event_KeyRelease) && event.key.virtualKey_ == 0) {
+                std::cerr << "Cannot send <no key> event" << std::endl;
+                continue;
+            }
+
+            if (delay > 0) {
+                if (!inputs.empty()) {
+                    sent += sendInputs(inputs);
+                    inputs.clear();
+                }
+                sleepUntil(monotonicTime() + static_cast<std::int64_t>(delay) * 1000000);
+                delay = 0;
+            }
+
+            inputs.push_back(toNativeInput(event));
+        }
+
+        if (!inputs.empty()) {
+            sent += sendInputs(inputs);
+        }
+
+        return sent;
+    }
+
+    /** Sends events without touching per-thread state, delays are ignored.
+     *
+     * Used to release held keys while the process exits, when the
+     * thread local buffers may already be destroyed.
+     *
+     * @returns number of events the system accepted.
+     */
+    inline std::size_t submitEventsAtExit(const InputEvent* events, std::size_t count)
+    {
+        std::vector<INPUT> inputs;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (events[i].type != Event_None) {
+                inputs.push_back(toNativeInput(events[i]));
+            }
+        }
+
+        return inputs.empty() ? 0 : ::SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+    }
+#endif
+
+#ifdef UNIX
+    /** X11 button numbers, indexed by MouseButton */
+    constexpr TranslationEntry<MouseButton, unsigned int> mouseButtonTable[] =
+    {
+        { MouseButton::Mouse_Left, 1 },
+        { MouseButton::Mouse_Middle, 2 },
+        { MouseButton::Mouse_Right, 3 }
+    };
+
+    static_assert(coversAllValues(mouseButtonTable, MouseButtonCount),
+        "mouseButtonTable must map every MouseButton, in declaration order");
+
+    /** Translates mouse button to the X11 button number */
+    constexpr unsigned int translateMouseButton(MouseButton button)
+    {
+        return button >= 0 && button < MouseButtonCount ? mouseButtonTable[button].code : 0;
+    }
+
+    /** Sends events over the connection without flushing it.
+     *
+     * Key events of <no key> are skipped. Event delays are passed in the
+     * XTest delay field, so the server paces the whole sequence and the
+     * client neither sleeps nor waits for replies.
+     *
+     * @returns number of events sent.
+     */
+    inline std::size_t sendXTestEvents(Display* dpy, const InputEvent* events, std::size_t count)
+    {
+        std::size_t sent = 0;
+        unsigned long delay = 0; // delays of skipped events carry over to the next one
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const InputEvent& event = events[i];
+            delay += event.delay;
+
+            switch (event.type)
+            {
+            case Event_KeyPress:
+            case Event_KeyRelease:
+                if (event.key.virtualKey_ == NoSymbol || event.key.code_ == 0) {
+                    std::cerr << "Cannot send <no key> event" << std::endl;
+                    continue;
+                }
+                XTestFakeKeyEvent(dpy, event.key.code_, event.type == Event_KeyPress, delay);
+                break;
+            case Event_ButtonPress:
+            case Event_ButtonRelease:
+                XTestFakeButtonEvent(dpy, translateMouseButton(event.button), event.type == Event_ButtonPress, delay);
+                break;
+            case Event_Move:
+                XTestFakeRelativeMotionEvent(dpy, event.x, event.y, delay);
+                break;
+            case Event_MoveTo:
+                XTestFakeMotionEvent(dpy, -1, event.x, event.y, delay); // -1 is the current screen
+                break;
+            case Event_MoveToNormalized:
+                XTestFakeMotionEvent(dpy, -1, ScreenGeometry::denormalizeX(event.x), ScreenGeometry::denormalizeY(event.y), delay);
+                break;
+            case Event_Wheel:
+            {
+                // X11 buttons: 4 = wheel up, 5 = wheel down
+                unsigned int wheelButton = event.y > 0 ? 4 : 5;
+                int steps = event.y > 0 ? event.y : -event.y;
+                for (int step = 0; step < steps; ++step)
+                {
+                    XTestFakeButtonEvent(dpy, wheelButton, true, step == 0 ? delay : CurrentTime);
+                    XTestFakeButtonEvent(dpy, wheelButton, false, CurrentTime);
+                }
+                break;
+            }
+            case Event_UnicodePress:
+            case Event_UnicodeRelease: // X11 text plans remap keycodes instead
+            case Event_None:
+                continue;
+            }
+            delay = 0;
+            ++sent;
+        }
+
+        return sent;
+    }
+
+    /** Sends events to the X server and flushes the connection once.
+     *
+     * @param events
+     *      Pointer to the first event.
+     * @param count
+     *      Number of events to send.
+     *
+     * @returns number of events sent.
+     */
+    inline std::size_t submitEvents(const InputEvent* events, std::size_t count)
+    {
+        TraceSpan span(Trace_Submit, static_cast<std::int64_t>(count));
+
+        Display* dpy = display();
+        if (!dpy) {
+            return 0;
+        }
+
+        std::size_t sent;
+        {
+            MetricsTimer timer(Metric_SubmitDuration);
+            sent = sendXTestEvents(dpy, events, count);
+
+            TraceSpan flush(Trace_Flush, static_cast<std::int64_t>(sent));
+            XFlush(dpy);
+        }
+
+        Metrics::count(Metric_Flushes);
+        Metrics::count(Metric_EventsSubmitted, sent);
+        return sent;
+    }
+
+    /** Sends events over a connection of its own.
+     *
+     * Used to release held keys while the process exits, when the
+     * thread's connection may already be closed.
+     *
+     * @returns number of events sent.
+     */
+    inline std::size_t submitEventsAtExit(const InputEvent* events, std::size_t count)
+    {
+        Display* dpy = XOpenDisplay(nullptr);
+        if (!dpy) {
+            return 0;
+        }
+
+        std::size_t sent = sendXTestEvents(dpy, events, count);
+        XCloseDisplay(dpy); // flushes
+        return sent;
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,460 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_INJECTOR_HPP
+#define FI_INJECTOR_HPP
+
+#include "config.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
+#include "metrics.hpp"
+#include "ring.hpp"
+#include "trace.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** What Injector does with an event posted to a full queue */
+    enum QueuePolicy {
+        Queue_Block, // sleep until the injector thread makes room
+        Queue_DropOldest, // discard the oldest queued event, but never a release
+        Queue_DropNewest // discard the posted event
+    };
+
+    /** Injects events on a dedicated thread.
+     *
+     * Any number of threads post events into a lock-free queue and return
+     * immediately. The injector thread drains the queue, merges adjacent
+     * relative moves and submits each drained run with one system call,
+     * so posting threads never wait for SendInput or the X server.
+     *
+     * Under Queue_DropOldest a key, button or unicode release taken out of
+     * the full queue is not dropped but submitted ahead of the next burst,
+     * so no key or button stays stuck down because of an overflow.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class Injector_base
+    {
+    public:
+        /** Starts the injector thread.
+         *
+         * @param capacity
+         *      Number of events the queue can hold.
+         * @param policy
+         *      Behaviour when the queue is full.
+         */
+        explicit Injector_base(std::size_t capacity = 4096, QueuePolicy policy = Queue_Block)
+            : queue_(capacity), policy_(policy)
+        {
+            thread_ = std::thread(&Injector_base::run_, this);
+        }
+
+        Injector_base(const Injector_base&) = delete;
+        Injector_base& operator=(const Injector_base&) = delete;
+
+        /** Submits what is queued and stops the injector thread. */
+        ~Injector_base()
+        {
+            stop();
+        }
+
+        /** Queues event for injection.
+         *
+         * @returns false if the event was dropped.
+         */
+        bool post(const InputEvent& event)
+        {
+            TraceSpan span(Trace_Enqueue, 1);
+
+            Queued_ entry;
+            entry.event = event;
+#ifdef FAKEINPUT_METRICS
+            entry.posted = Metrics::now();
+#endif
+
+            bool queued = queue_.tryPush(entry);
+            while (!queued)
+            {
+                if (policy_ == Queue_DropNewest)
+                {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                if (policy_ == Queue_DropOldest)
+                {
+                    Queued_ oldest;
+                    if (queue_.tryPop(oldest))
+                    {
+                        if (isRelease_(oldest.event.type))
+                        {
+                            rescue_(oldest.event);
+                        }
+                        else
+                        {
+                            dropped_.fetch_add(1, std::memory_order_relaxed);
+                            completed_.fetch_add(1);
+                        }
+                    }
+                    queued = queue_.tryPush(entry);
+                }
+                else if (!waitForRoom_(entry))
+                {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return false; // the injector stopped, nobody makes room anymore
+                }
+                else
+                {
+                    queued = true;
+                }
+            }
+
+            posted_.fetch_add(1);
+            wake_();
+            return true;
+        }
+
+        bool pressKey(Key key)
+        {
+            return postKeyEvent_(key, Event_KeyPress);
+        }
+
+        bool releaseKey(Key key)
+        {
+            return postKeyEvent_(key, Event_KeyRelease);
+        }
+
+        bool pressButton(MouseButton button)
+        {
+            return postButtonEvent_(button, Event_ButtonPress);
+        }
+
+        bool releaseButton(MouseButton button)
+        {
+            return postButtonEvent_(button, Event_ButtonRelease);
+        }
+
+        bool move(int dx, int dy)
+        {
+            return postPointerEvent_(Event_Move, dx, dy);
+        }
+
+        bool moveTo(int x, int y)
+        {
+            return postPointerEvent_(Event_MoveTo, x, y);
+        }
+
+        bool wheelUp()
+        {
+            return postPointerEvent_(Event_Wheel, 0, 1);
+        }
+
+        bool wheelDown()
+        {
+            return postPointerEvent_(Event_Wheel, 0, -1);
+        }
+
+        /** Waits until every event posted so far is submitted or dropped. */
+        void flush()
+        {
+            std::uint64_t target = posted_.load();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++flushWaiters_;
+            drained_.wait(lock, [&] {
+                return completed_.load() >= target || stopped_;
+            });
+            --flushWaiters_;
+        }
+
+        /** Submits what is queued and stops the injector thread.
+         *
+         * Events posted after stop() stay in the queue.
+         */
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_)
+                {
+                    return;
+                }
+                stopping_ = true;
+            }
+            wakeup_.notify_one();
+
+            if (thread_.joinable())
+            {
+                thread_.join();
+            }
+        }
+
+        /** Number of events dropped because the queue was full. */
+        std::uint64_t droppedCount() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+        std::size_t capacity() const
+        {
+            return queue_.capacity();
+        }
+
+    private:
+        /** Upper bound of events submitted with one system call */
+        static constexpr std::size_t MaxBurst_ = 512;
+
+        struct Queued_
+        {
+            InputEvent event;
+#ifdef FAKEINPUT_METRICS
+            std::int64_t posted; // Metrics::now() in post()
+#endif
+        };
+
+        static bool isRelease_(EventType type)
+        {
+            return type == Event_KeyRelease || type == Event_ButtonRelease || type == Event_UnicodeRelease;
+        }
+
+        /** Keeps release taken out of the full queue for the next burst. */
+        void rescue_(const InputEvent& event)
+        {
+            std::lock_guard<std::mutex> lock(rescueMutex_);
+            rescued_.push_back(event);
+            hasRescued_.store(true, std::memory_order_release);
+        }
+
+        /** Blocks until the entry fits the queue.
+         *
+         * @returns false if the injector stopped meanwhile.
+         */
+        bool waitForRoom_(const Queued_& entry)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            blockedProducers_.fetch_add(1);
+            // pairs with the fence in notifyBlockedProducers_(), either the
+            // injector sees us blocked or we see the room it made
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool queued = false;
+            roomMade_.wait(lock, [&] {
+                queued = queue_.tryPush(entry);
+                return queued || stopped_;
+            });
+
+            blockedProducers_.fetch_sub(1);
+            return queued;
+        }
+
+        void notifyBlockedProducers_()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (blockedProducers_.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                roomMade_.notify_all();
+            }
+        }
+
+        bool postKeyEvent_(Key key, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.key = key;
+            return post(event);
+        }
+
+        bool postButtonEvent_(MouseButton button, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.button = button;
+            return post(event);
+        }
+
+        bool postPointerEvent_(EventType type, int x, int y)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.x = x;
+            event.y = y;
+            return post(event);
+        }
+
+        void wake_()
+        {
+            // pairs with the fence in sleep_(), either the injector sees the
+            // event or we see it going to sleep
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeping_.load(std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                wakeup_.notify_one();
+            }
+        }
+
+        /** @returns false when the injector should exit. */
+        bool sleep_()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            wakeup_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+            sleeping_.store(false, std::memory_order_relaxed);
+
+            return !stopping_ || !queue_.empty();
+        }
+
+        void run_()
+        {
+            std::vector<InputEvent> burst;
+            burst.reserve(MaxBurst_);
+#ifdef FAKEINPUT_METRICS
+            std::vector<std::int64_t> postTimes;
+            postTimes.reserve(MaxBurst_);
+#endif
+
+            for (;;)
+            {
+                std::size_t drained = 0;
+                if (hasRescued_.load(std::memory_order_acquire))
+                {
+                    std::lock_guard<std::mutex> lock(rescueMutex_);
+                    burst.insert(burst.end(), rescued_.begin(), rescued_.end());
+                    drained = rescued_.size();
+                    rescued_.clear();
+                    hasRescued_.store(false, std::memory_order_relaxed);
+                }
+
+                Queued_ entry;
+                while (drained < MaxBurst_ && queue_.tryPop(entry))
+                {
+                    ++drained;
+                    if (drained % 64 == 0)
+                    {
+                        notifyBlockedProducers_(); // let them refill while we drain
+                    }
+#ifdef FAKEINPUT_METRICS
+                    postTimes.push_back(entry.posted);
+#endif
+
+                    const InputEvent& event = entry.event;
+
+                    // merge adjacent relative moves into one, unless timed apart
+                    if (event.type == Event_Move && event.delay == 0 && !burst.empty() && burst.back().type == Event_Move)
+                    {
+                        burst.back().x += event.x;
+                        burst.back().y += event.y;
+                        continue;
+                    }
+
+                    burst.push_back(event);
+                }
+
+                if (drained > 0)
+                {
+#ifdef FAKEINPUT_METRICS
+                    std::int64_t now = Metrics::now();
+                    for (std::int64_t posted : postTimes)
+                    {
+                        Metrics::record(Metric_EnqueueToSubmit, now - posted);
+                    }
+                    postTimes.clear();
+#endif
+                    Backend_t::submit(burst.data(), burst.size());
+                    burst.clear();
+
+                    completed_.fetch_add(drained);
+                    notifyBlockedProducers_();
+                    notifyFlushWaiters_();
+                }
+                else if (!queue_.empty())
+                {
+                    std::this_thread::yield(); // a producer is still writing its slot
+                }
+                else if (!sleep_())
+                {
+                    break;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+            drained_.notify_all();
+            roomMade_.notify_all();
+        }
+
+        void notifyFlushWaiters_()
+        {
+            // both sides use sequentially consistent operations, either the
+            // waiter sees the new count or we see the waiter
+            if (flushWaiters_.load() > 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                drained_.notify_all();
+            }
+        }
+
+        MpscRing<Queued_> queue_;
+        QueuePolicy policy_;
+
+        std::atomic<std::uint64_t> posted_{ 0 };
+        std::atomic<std::uint64_t> completed_{ 0 };
+        std::atomic<std::uint64_t> dropped_{ 0 };
+        std::atomic<bool> sleeping_{ false };
+
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::condition_variable drained_;
+        std::condition_variable roomMade_;
+        std::atomic<unsigned> flushWaiters_{ 0 };
+        std::atomic<unsigned> blockedProducers_{ 0 };
+
+        std::mutex rescueMutex_;
+        std::vector<InputEvent> rescued_; // releases taken out of the full queue
+        std::atomic<bool> hasRescued_{ false };
+        bool stopping_ = false;
+        bool stopped_ = false;
+
+        std::thread thread_;
+    };
+
+    using Injector = Injector_base<SystemBackend>;
+}
+
+#endif
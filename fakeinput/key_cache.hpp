@@ -0,0 +1,180 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_KEY_CACHE_HPP
+#define FI_KEY_CACHE_HPP
+
+#include "config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Precomputed keys for all key types and the first 256 virtual keys.
+     *
+     * Looking a key up is a single atomic load, the platform is asked only
+     * when the cache is (re)built. The cache is built on first use and
+     * must be invalidated when the keyboard layout or mapping changes.
+     *
+     * Every key is stored as one 64-bit atomic, which a rebuild overwrites
+     * in place. A concurrent lookup therefore gets the old or the new key,
+     * never a torn one, and no table is ever freed or reused under a
+     * reader. A generation counter tells whether the cache matches the
+     * last invalidate(). If the platform cannot resolve keys at the moment
+     * (no X display), nothing is published and lookups are resolved
+     * directly until a rebuild succeeds.
+     *
+     * @tparam Resolver_t
+     *      Provides static fromKeyType(KeyType) and fromKeycode(std::uint32_t)
+     *      which resolve keys through the platform, and beginRebuild()
+     *      called before the cache is filled, returning false if keys
+     *      cannot be resolved now.
+     */
+    template<typename Resolver_t>
+    class KeyCache_base
+    {
+    public:
+        /** Number of virtual keys held in the cache */
+        static constexpr std::uint32_t VirtualKeyCount = 256;
+
+        static Key fromKeyType(KeyType type)
+        {
+            if (type < 0 || type >= KeyTypeCount)
+            {
+                return {};
+            }
+            if (!ensureBuilt_())
+            {
+                return Resolver_t::fromKeyType(type);
+            }
+
+            return unpack_(table_().byKeyType[type].load(std::memory_order_relaxed));
+        }
+
+        /** Gets key of the virtual key, those out of the cached range are resolved directly. */
+        static Key fromKeycode(std::uint32_t virtualKey)
+        {
+            if (virtualKey >= VirtualKeyCount || !ensureBuilt_())
+            {
+                return Resolver_t::fromKeycode(virtualKey);
+            }
+
+            return unpack_(table_().byKeycode[virtualKey].load(std::memory_order_relaxed));
+        }
+
+        /** Marks the cache stale, it is rebuilt on the next lookup. */
+        static void invalidate()
+        {
+            table_().generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        /** Rebuilds the cache immediately.
+         *
+         * @returns false if the platform cannot resolve keys now.
+         */
+        static bool rebuild()
+        {
+            return rebuild_(true);
+        }
+
+    private:
+        struct Table_
+        {
+            std::atomic<std::uint64_t> byKeyType[KeyTypeCount];
+            std::atomic<std::uint64_t> byKeycode[VirtualKeyCount];
+            std::atomic<std::uint64_t> generation{ 1 }; // bumped by invalidate()
+            std::atomic<std::uint64_t> builtGeneration{ 0 }; // generation the keys belong to
+        };
+
+        static_assert(sizeof(Key) <= sizeof(std::uint64_t), "Key must fit one atomic word");
+
+        static std::uint64_t pack_(Key key)
+        {
+            std::uint64_t word = 0;
+            std::memcpy(&word, &key, sizeof(key));
+            return word;
+        }
+
+        static Key unpack_(std::uint64_t word)
+        {
+            Key key;
+            std::memcpy(static_cast<void*>(&key), &word, sizeof(key));
+            return key;
+        }
+
+        static Table_& table_()
+        {
+            static Table_ table;
+            return table;
+        }
+
+        static bool ensureBuilt_()
+        {
+            const Table_& table = table_();
+            if (table.builtGeneration.load(std::memory_order_acquire) == table.generation.load(std::memory_order_acquire))
+            {
+                return true;
+            }
+
+            return rebuild_(false);
+        }
+
+        static bool rebuild_(bool force)
+        {
+            static std::mutex mutex;
+            std::lock_guard<std::mutex> lock(mutex);
+
+            Table_& table = table_();
+            std::uint64_t generation = table.generation.load(std::memory_order_acquire);
+            if (!force && table.builtGeneration.load(std::memory_order_relaxed) == generation)
+            {
+                return true; // rebuilt by another thread meanwhile
+            }
+
+            if (!Resolver_t::beginRebuild())
+            {
+                return false;
+            }
+
+            for (int type = 0; type < KeyTypeCount; ++type)
+            {
+                table.byKeyType[type].store(pack_(Resolver_t::fromKeyType(static_cast<KeyType>(type))), std::memory_order_relaxed);
+            }
+            for (std::uint32_t virtualKey = 0; virtualKey < VirtualKeyCount; ++virtualKey)
+            {
+                table.byKeycode[virtualKey].store(pack_(Resolver_t::fromKeycode(virtualKey)), std::memory_order_relaxed);
+            }
+
+            // an invalidate() during the rebuild leaves the generations apart
+            table.builtGeneration.store(generation, std::memory_order_release);
+            return true;
+        }
+    };
+}
+
+#endif
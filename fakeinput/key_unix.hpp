@@ -29,95 +29,270 @@
 #ifdef UNIX
 
 #include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/XF86keysym.h>
 
+#include <cstdint>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
 
-#include "key_base.hpp"
+#include "display_unix.hpp"
+#include "key_cache.hpp"
 #include "types.hpp"
 
 namespace FakeInput
 {
-    inline unsigned int translateKey(KeyType type) 
+    /** Key symbols of the key types, indexed by KeyType */
+    constexpr TranslationEntry<KeyType, unsigned int> keyTypeTable[] =
     {
-        static const std::unordered_map<KeyType, unsigned int> keyMap = 
-        {
-            { KeyType::Key_A, XK_A },
-            { KeyType::Key_B, XK_B },
-            { KeyType::Key_C, XK_C },
-            { KeyType::Key_D, XK_D },
-            { KeyType::Key_E, XK_E },
-            { KeyType::Key_F, XK_F },
-            { KeyType::Key_G, XK_G },
-            { KeyType::Key_H, XK_H },
-            { KeyType::Key_I, XK_I },
-            { KeyType::Key_J, XK_J },
-            { KeyType::Key_K, XK_K },
-            { KeyType::Key_L, XK_L },
-            { KeyType::Key_M, XK_M },
-            { KeyType::Key_N, XK_N },
-            { KeyType::Key_O, XK_O },
-            { KeyType::Key_P, XK_P },
-            { KeyType::Key_Q, XK_Q },
-            { KeyType::Key_R, XK_R },
-            { KeyType::Key_S, XK_S },
-            { KeyType::Key_T, XK_T },
-            { KeyType::Key_U, XK_U },
-            { KeyType::Key_V, XK_V },
-            { KeyType::Key_W, XK_W },
-            { KeyType::Key_X, XK_X },
-            { KeyType::Key_Y, XK_Y },
-            { KeyType::Key_Z, XK_Z },
-            { KeyType::Key_Enter, XK_Return },
-            { KeyType::Key_Escape, XK_Escape },
-            { KeyType::Key_Space, XK_space },
-            { KeyType::Key_Backspace, XK_BackSpace },
-            { KeyType::Key_Tab, XK_Tab },
-            { KeyType::Key_VolumeUp, XF86XK_AudioRaiseVolume },
-            { KeyType::Key_VolumeDown, XF86XK_AudioLowerVolume },
-            { KeyType::Key_VolumeMute, XF86XK_AudioMute },
-            { KeyType::Key_MediaPlayPause, XF86XK_AudioPlay },
-            { KeyType::Key_MediaNext, XF86XK_AudioNext },
-            { KeyType::Key_MediaPrev, XF86XK_AudioPrev },
-            { KeyType::Key_MediaStop, XF86XK_AudioStop }
-        };
-
-        auto it = keyMap.find(type);
-        return it != keyMap.end() ? it->second : 0;
+        { KeyType::Key_A, XK_A },
+        { KeyType::Key_B, XK_B },
+        { KeyType::Key_C, XK_C },
+        { KeyType::Key_D, XK_D },
+        { KeyType::Key_E, XK_E },
+        { KeyType::Key_F, XK_F },
+        { KeyType::Key_G, XK_G },
+        { KeyType::Key_H, XK_H },
+        { KeyType::Key_I, XK_I },
+        { KeyType::Key_J, XK_J },
+        { KeyType::Key_K, XK_K },
+        { KeyType::Key_L, XK_L },
+        { KeyType::Key_M, XK_M },
+        { KeyType::Key_N, XK_N },
+        { KeyType::Key_O, XK_O },
+        { KeyType::Key_P, XK_P },
+        { KeyType::Key_Q, XK_Q },
+        { KeyType::Key_R, XK_R },
+        { KeyType::Key_S, XK_S },
+        { KeyType::Key_T, XK_T },
+        { KeyType::Key_U, XK_U },
+        { KeyType::Key_V, XK_V },
+        { KeyType::Key_W, XK_W },
+        { KeyType::Key_X, XK_X },
+        { KeyType::Key_Y, XK_Y },
+        { KeyType::Key_Z, XK_Z },
+        { KeyType::Key_0, XK_0 },
+        { KeyType::Key_1, XK_1 },
+        { KeyType::Key_2, XK_2 },
+        { KeyType::Key_3, XK_3 },
+        { KeyType::Key_4, XK_4 },
+        { KeyType::Key_5, XK_5 },
+        { KeyType::Key_6, XK_6 },
+        { KeyType::Key_7, XK_7 },
+        { KeyType::Key_8, XK_8 },
+        { KeyType::Key_9, XK_9 },
+        { KeyType::Key_F1, XK_F1 },
+        { KeyType::Key_F2, XK_F2 },
+        { KeyType::Key_F3, XK_F3 },
+        { KeyType::Key_F4, XK_F4 },
+        { KeyType::Key_F5, XK_F5 },
+        { KeyType::Key_F6, XK_F6 },
+        { KeyType::Key_F7, XK_F7 },
+        { KeyType::Key_F8, XK_F8 },
+        { KeyType::Key_F9, XK_F9 },
+        { KeyType::Key_F10, XK_F10 },
+        { KeyType::Key_F11, XK_F11 },
+        { KeyType::Key_F12, XK_F12 },
+        { KeyType::Key_F13, XK_F13 },
+        { KeyType::Key_F14, XK_F14 },
+        { KeyType::Key_F15, XK_F15 },
+        { KeyType::Key_F16, XK_F16 },
+        { KeyType::Key_F17, XK_F17 },
+        { KeyType::Key_F18, XK_F18 },
+        { KeyType::Key_F19, XK_F19 },
+        { KeyType::Key_F20, XK_F20 },
+        { KeyType::Key_F21, XK_F21 },
+        { KeyType::Key_F22, XK_F22 },
+        { KeyType::Key_F23, XK_F23 },
+        { KeyType::Key_F24, XK_F24 },
+        { KeyType::Key_Escape, XK_Escape },
+        { KeyType::Key_Space, XK_space },
+        { KeyType::Key_Return, XK_Return },
+        { KeyType::Key_Backspace, XK_BackSpace },
+        { KeyType::Key_Tab, XK_Tab },
+        { KeyType::Key_Shift_L, XK_Shift_L },
+        { KeyType::Key_Shift_R, XK_Shift_R },
+        { KeyType::Key_Control_L, XK_Control_L },
+        { KeyType::Key_Control_R, XK_Control_R },
+        { KeyType::Key_Alt_L, XK_Alt_L },
+        { KeyType::Key_Alt_R, XK_Alt_R },
+        { KeyType::Key_Win_L, XK_Super_L },
+        { KeyType::Key_Win_R, XK_Super_R },
+        { KeyType::Key_Apps, XK_Menu },
+        { KeyType::Key_CapsLock, XK_Caps_Lock },
+        { KeyType::Key_NumLock, XK_Num_Lock },
+        { KeyType::Key_ScrollLock, XK_Scroll_Lock },
+        { KeyType::Key_PrintScreen, XK_Print },
+        { KeyType::Key_Pause, XK_Pause },
+        { KeyType::Key_Insert, XK_Insert },
+        { KeyType::Key_Delete, XK_Delete },
+        { KeyType::Key_PageUP, XK_Page_Up },
+        { KeyType::Key_PageDown, XK_Page_Down },
+        { KeyType::Key_Home, XK_Home },
+        { KeyType::Key_End, XK_End },
+        { KeyType::Key_Left, XK_Left },
+        { KeyType::Key_Right, XK_Right },
+        { KeyType::Key_Up, XK_Up },
+        { KeyType::Key_Down, XK_Down },
+        { KeyType::Key_Numpad0, XK_KP_0 },
+        { KeyType::Key_Numpad1, XK_KP_1 },
+        { KeyType::Key_Numpad2, XK_KP_2 },
+        { KeyType::Key_Numpad3, XK_KP_3 },
+        { KeyType::Key_Numpad4, XK_KP_4 },
+        { KeyType::Key_Numpad5, XK_KP_5 },
+        { KeyType::Key_Numpad6, XK_KP_6 },
+        { KeyType::Key_Numpad7, XK_KP_7 },
+        { KeyType::Key_Numpad8, XK_KP_8 },
+        { KeyType::Key_Numpad9, XK_KP_9 },
+        { KeyType::Key_NumpadAdd, XK_KP_Add },
+        { KeyType::Key_NumpadSubtract, XK_KP_Subtract },
+        { KeyType::Key_NumpadMultiply, XK_KP_Multiply },
+        { KeyType::Key_NumpadDivide, XK_KP_Divide },
+        { KeyType::Key_NumpadDecimal, XK_KP_Decimal },
+        { KeyType::Key_NumpadEnter, XK_KP_Enter },
+        { KeyType::Key_MediaPlayPause, XF86XK_AudioPlay },
+        { KeyType::Key_MediaNext, XF86XK_AudioNext },
+        { KeyType::Key_MediaPrev, XF86XK_AudioPrev },
+        { KeyType::Key_MediaStop, XF86XK_AudioStop },
+        { KeyType::Key_VolumeUp, XF86XK_AudioRaiseVolume },
+        { KeyType::Key_VolumeDown, XF86XK_AudioLowerVolume },
+        { KeyType::Key_VolumeMute, XF86XK_AudioMute }
+    };
+
+    static_assert(coversAllValues(keyTypeTable, KeyTypeCount),
+        "keyTypeTable must map every KeyType, in declaration order");
+
+    /** Translates key type to the key symbol.
+     *
+     * @returns key symbol or NoSymbol for Key_NoKey.
+     */
+    constexpr unsigned int translateKey(KeyType type)
+    {
+        return type >= 0 && type < KeyTypeCount ? keyTypeTable[type].code : NoSymbol;
     }
 
-    auto CreateKeyFromKeyType(KeyType type)
+    /** Resolves key of the key symbol through the X server, bypassing KeyCache. */
+    inline auto resolveKeyFromKeycode(KeySym keysym) -> Key
     {
         Key k{};
-
-        k.virtualKeycode_ = translateKey(type);
-        k.code_ = XKeysymToKeycode(display(), keysym_);
-        k.name_ = XKeysymToString(keysym_);
+        Display* dpy = display();
+        k.code_ = dpy ? XKeysymToKeycode(dpy, keysym) : 0;
+        k.virtualKey_ = static_cast<std::uint32_t>(keysym);
         return k;
     }
 
-    auto CreateKeyFromEvent(XEvent* event)
+    /** Resolves key of the key type through the X server, bypassing KeyCache. */
+    inline auto resolveKeyFromKeyType(KeyType type) -> Key
     {
-        if (event->type != KeyPress && event->type != KeyRelease)
-            throw std::logic_error("Cannot get key from non-key event");
+        if (type == Key_NoKey)
+        {
+            return {};
+        }
 
-        Key k{};
+        return resolveKeyFromKeycode(translateKey(type));
+    }
 
-        k.code_ = event->xkey.keycode;
-        k.virtualKeycode_ = XKeycodeToKeysym(event->xkey.display, code_, 0);
-        k.name_ = XKeysymToString(keysym_);
-        return k;
+    struct KeyResolver
+    {
+        /** Reloads keyboard mapping of this thread's connection.
+         *
+         * Injecting connections never read their events, so they do not
+         * see MappingNotify themselves and would keep the stale mapping.
+         */
+        static bool beginRebuild()
+        {
+            Display* dpy = display();
+            if (!dpy)
+            {
+                return false; // keys of no display must not be cached
+            }
+
+            int minKeycode = 0;
+            int maxKeycode = 0;
+            XDisplayKeycodes(dpy, &minKeycode, &maxKeycode);
+
+            XMappingEvent mapping{};
+            mapping.type = MappingNotify;
+            mapping.display = dpy;
+            mapping.request = MappingKeyboard;
+            mapping.first_keycode = minKeycode;
+            mapping.count = maxKeycode - minKeycode + 1;
+            XRefreshKeyboardMapping(&mapping);
+            return true;
+        }
+
+        static Key fromKeyType(KeyType type)
+        {
+            return resolveKeyFromKeyType(type);
+        }
+
+        static Key fromKeycode(std::uint32_t keysym)
+        {
+            return resolveKeyFromKeycode(keysym);
+        }
+    };
+
+    /** Keys precomputed for the current X keyboard mapping.
+     *
+     * Caches all key types and the Latin-1 key symbols. Call
+     * refreshKeyCache() for every MappingNotify event received.
+     */
+    using KeyCache = KeyCache_base<KeyResolver>;
+
+    inline auto CreateKeyFromKeycode(KeySym keysym) -> Key
+    {
+        return KeyCache::fromKeycode(static_cast<std::uint32_t>(keysym));
     }
 
-    auto CreateKeyFromKeycode(KeySym keySym)
+    inline auto CreateKeyFromKeyType(KeyType type) -> Key
     {
-        Key k{};
-        k.code_ = XKeysymToKeycode(display(), keysym);
-        k.virtualKeycode_ = keysym;
-        k.name_ = XKeysymToString(keysym);
+        return KeyCache::fromKeyType(type);
+    }
+
+    /** Updates keyboard mapping and invalidates KeyCache on MappingNotify.
+     *
+     * @param event
+     *      Event received from the X server.
+     *
+     * @returns whether the cache was invalidated.
+     */
+    inline bool refreshKeyCache(XEvent* event)
+    {
+        if (event->type != MappingNotify || event->xmapping.request == MappingPointer)
+        {
+            return false;
+        }
+
+        XRefreshKeyboardMapping(&event->xmapping);
+        KeyCache::invalidate();
+        return true;
+    }
+
+    /** Gets human readable name of the key.
+     *
+     * Names are looked up only on request, keys themselves carry no name.
+     */
+    inline std::string keyName(Key key)
+    {
+        if (key.virtualKey_ == NoSymbol)
+        {
+            return "<no key>";
+        }
+
+        const char* name = XKeysymToString(key.virtualKey_);
+        return name ? name : "<unknown>";
+    }
+
+    inline auto CreateKeyFromEvent(XEvent* event) -> Key
+    {
+        if (event->type != KeyPress && event->type != KeyRelease)
+            throw std::logic_error("Cannot get key from non-key event");
+
+        Key k = CreateKeyFromKeycode(XLookupKeysym(&event->xkey, 0));
+        k.code_ = static_cast<std::uint8_t>(event->xkey.keycode);
         return k;
     }
 }
 
 #endif
-#endif
\ No newline at end of file
+#endif
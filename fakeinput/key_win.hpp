@@ -37,69 +37,153 @@
 #include <Windows.h>
 
 
+#include <cstdint>
 #include <string>
 #include <exception>
 #include <iostream>
+#include <mutex>
 #include <vector>
-#include <unordered_map>
+#include "key_cache.hpp"
 #include "types.hpp"
 
 namespace FakeInput
 {
-    inline WORD translateKey(KeyType type) 
+    /** Virtual keys of the key types, indexed by KeyType */
+    constexpr TranslationEntry<KeyType, WORD> keyTypeTable[] =
     {
-        static const std::unordered_map<KeyType, WORD> keyMap = 
-        {
-            { KeyType::Key_A, 'A' },
-            { KeyType::Key_B, 'B' },
-            { KeyType::Key_C, 'C' },
-            { KeyType::Key_D, 'D' },
-            { KeyType::Key_E, 'E' },
-            { KeyType::Key_F, 'F' },
-            { KeyType::Key_G, 'G' },
-            { KeyType::Key_H, 'H' },
-            { KeyType::Key_I, 'I' },
-            { KeyType::Key_J, 'J' },
-            { KeyType::Key_K, 'K' },
-            { KeyType::Key_L, 'L' },
-            { KeyType::Key_M, 'M' },
-            { KeyType::Key_N, 'N' },
-            { KeyType::Key_O, 'O' },
-            { KeyType::Key_P, 'P' },
-            { KeyType::Key_Q, 'Q' },
-            { KeyType::Key_R, 'R' },
-            { KeyType::Key_S, 'S' },
-            { KeyType::Key_T, 'T' },
-            { KeyType::Key_U, 'U' },
-            { KeyType::Key_V, 'V' },
-            { KeyType::Key_W, 'W' },
-            { KeyType::Key_X, 'X' },
-            { KeyType::Key_Y, 'Y' },
-            { KeyType::Key_Z, 'Z' },
-            { KeyType::Key_Return, VK_RETURN },
-            { KeyType::Key_Escape, VK_ESCAPE },
-            { KeyType::Key_Space, VK_SPACE },
-            { KeyType::Key_Backspace, VK_BACK },
-            { KeyType::Key_Tab, VK_TAB },
-            { KeyType::Key_VolumeUp, VK_VOLUME_UP },
-            { KeyType::Key_VolumeDown, VK_VOLUME_DOWN },
-            { KeyType::Key_VolumeMute, VK_VOLUME_MUTE },
-            { KeyType::Key_MediaPlayPause, VK_MEDIA_PLAY_PAUSE },
-            { KeyType::Key_MediaNext, VK_MEDIA_NEXT_TRACK },
-            { KeyType::Key_MediaPrev, VK_MEDIA_PREV_TRACK },
-            { KeyType::Key_MediaStop, VK_MEDIA_STOP }
-        };
-
-        auto it = keyMap.find(type);
-        return it != keyMap.end() ? it->second : 0;
+        { KeyType::Key_A, 'A' },
+        { KeyType::Key_B, 'B' },
+        { KeyType::Key_C, 'C' },
+        { KeyType::Key_D, 'D' },
+        { KeyType::Key_E, 'E' },
+        { KeyType::Key_F, 'F' },
+        { KeyType::Key_G, 'G' },
+        { KeyType::Key_H, 'H' },
+        { KeyType::Key_I, 'I' },
+        { KeyType::Key_J, 'J' },
+        { KeyType::Key_K, 'K' },
+        { KeyType::Key_L, 'L' },
+        { KeyType::Key_M, 'M' },
+        { KeyType::Key_N, 'N' },
+        { KeyType::Key_O, 'O' },
+        { KeyType::Key_P, 'P' },
+        { KeyType::Key_Q, 'Q' },
+        { KeyType::Key_R, 'R' },
+        { KeyType::Key_S, 'S' },
+        { KeyType::Key_T, 'T' },
+        { KeyType::Key_U, 'U' },
+        { KeyType::Key_V, 'V' },
+        { KeyType::Key_W, 'W' },
+        { KeyType::Key_X, 'X' },
+        { KeyType::Key_Y, 'Y' },
+        { KeyType::Key_Z, 'Z' },
+        { KeyType::Key_0, '0' },
+        { KeyType::Key_1, '1' },
+        { KeyType::Key_2, '2' },
+        { KeyType::Key_3, '3' },
+        { KeyType::Key_4, '4' },
+        { KeyType::Key_5, '5' },
+        { KeyType::Key_6, '6' },
+        { KeyType::Key_7, '7' },
+        { KeyType::Key_8, '8' },
+        { KeyType::Key_9, '9' },
+        { KeyType::Key_F1, VK_F1 },
+        { KeyType::Key_F2, VK_F2 },
+        { KeyType::Key_F3, VK_F3 },
+        { KeyType::Key_F4, VK_F4 },
+        { KeyType::Key_F5, VK_F5 },
+        { KeyType::Key_F6, VK_F6 },
+        { KeyType::Key_F7, VK_F7 },
+        { KeyType::Key_F8, VK_F8 },
+        { KeyType::Key_F9, VK_F9 },
+        { KeyType::Key_F10, VK_F10 },
+        { KeyType::Key_F11, VK_F11 },
+        { KeyType::Key_F12, VK_F12 },
+        { KeyType::Key_F13, VK_F13 },
+        { KeyType::Key_F14, VK_F14 },
+        { KeyType::Key_F15, VK_F15 },
+        { KeyType::Key_F16, VK_F16 },
+        { KeyType::Key_F17, VK_F17 },
+        { KeyType::Key_F18, VK_F18 },
+        { KeyType::Key_F19, VK_F19 },
+        { KeyType::Key_F20, VK_F20 },
+        { KeyType::Key_F21, VK_F21 },
+        { KeyType::Key_F22, VK_F22 },
+        { KeyType::Key_F23, VK_F23 },
+        { KeyType::Key_F24, VK_F24 },
+        { KeyType::Key_Escape, VK_ESCAPE },
+        { KeyType::Key_Space, VK_SPACE },
+        { KeyType::Key_Return, VK_RETURN },
+        { KeyType::Key_Backspace, VK_BACK },
+        { KeyType::Key_Tab, VK_TAB },
+        { KeyType::Key_Shift_L, VK_LSHIFT },
+        { KeyType::Key_Shift_R, VK_RSHIFT },
+        { KeyType::Key_Control_L, VK_LCONTROL },
+        { KeyType::Key_Control_R, VK_RCONTROL },
+        { KeyType::Key_Alt_L, VK_LMENU },
+        { KeyType::Key_Alt_R, VK_RMENU },
+        { KeyType::Key_Win_L, VK_LWIN },
+        { KeyType::Key_Win_R, VK_RWIN },
+        { KeyType::Key_Apps, VK_APPS },
+        { KeyType::Key_CapsLock, VK_CAPITAL },
+        { KeyType::Key_NumLock, VK_NUMLOCK },
+        { KeyType::Key_ScrollLock, VK_SCROLL },
+        { KeyType::Key_PrintScreen, VK_SNAPSHOT },
+        { KeyType::Key_Pause, VK_PAUSE },
+        { KeyType::Key_Insert, VK_INSERT },
+        { KeyType::Key_Delete, VK_DELETE },
+        { KeyType::Key_PageUP, VK_PRIOR },
+        { KeyType::Key_PageDown, VK_NEXT },
+        { KeyType::Key_Home, VK_HOME },
+        { KeyType::Key_End, VK_END },
+        { KeyType::Key_Left, VK_LEFT },
+        { KeyType::Key_Right, VK_RIGHT },
+        { KeyType::Key_Up, VK_UP },
+        { KeyType::Key_Down, VK_DOWN },
+        { KeyType::Key_Numpad0, VK_NUMPAD0 },
+        { KeyType::Key_Numpad1, VK_NUMPAD1 },
+        { KeyType::Key_Numpad2, VK_NUMPAD2 },
+        { KeyType::Key_Numpad3, VK_NUMPAD3 },
+        { KeyType::Key_Numpad4, VK_NUMPAD4 },
+        { KeyType::Key_Numpad5, VK_NUMPAD5 },
+        { KeyType::Key_Numpad6, VK_NUMPAD6 },
+        { KeyType::Key_Numpad7, VK_NUMPAD7 },
+        { KeyType::Key_Numpad8, VK_NUMPAD8 },
+        { KeyType::Key_Numpad9, VK_NUMPAD9 },
+        { KeyType::Key_NumpadAdd, VK_ADD },
+        { KeyType::Key_NumpadSubtract, VK_SUBTRACT },
+        { KeyType::Key_NumpadMultiply, VK_MULTIPLY },
+        { KeyType::Key_NumpadDivide, VK_DIVIDE },
+        { KeyType::Key_NumpadDecimal, VK_DECIMAL },
+        { KeyType::Key_NumpadEnter, VK_RETURN },
+        { KeyType::Key_MediaPlayPause, VK_MEDIA_PLAY_PAUSE },
+        { KeyType::Key_MediaNext, VK_MEDIA_NEXT_TRACK },
+        { KeyType::Key_MediaPrev, VK_MEDIA_PREV_TRACK },
+        { KeyType::Key_MediaStop, VK_MEDIA_STOP },
+        { KeyType::Key_VolumeUp, VK_VOLUME_UP },
+        { KeyType::Key_VolumeDown, VK_VOLUME_DOWN },
+        { KeyType::Key_VolumeMute, VK_VOLUME_MUTE }
+    };
+
+    static_assert(coversAllValues(keyTypeTable, KeyTypeCount),
+        "keyTypeTable must map every KeyType, in declaration order");
+
+    /** Translates key type to the virtual key.
+     *
+     * @returns virtual key or 0 for Key_NoKey.
+     */
+    constexpr WORD translateKey(KeyType type)
+    {
+        return type >= 0 && type < KeyTypeCount ? keyTypeTable[type].code : 0;
     }
 
-    auto CreateKeyFromKeycode(WORD virtualKey) -> Key
+    /** Resolves key of the virtual key through the system, bypassing KeyCache. */
+    inline auto resolveKeyFromKeycode(WORD virtualKey) -> Key
     {
         Key k{};
         k.virtualKey_ = virtualKey;
 
-        k.code_ = MapVirtualKey(virtualKey, MAPVK_VK_TO_VSC);
+        k.code_ = static_cast<WORD>(MapVirtualKey(virtualKey, MAPVK_VK_TO_VSC));
 
         // If MapVirtualKey returns 0 OR the key is one of the known multimedia keys,
         // force the input to use only virtual key.
@@ -115,11 +199,10 @@ namespace FakeInput
 
         if (useVirtualKeyOnly) {
             k.code_ = 0; // disable scancode path
-            k.name_ = "<virtual key only>";
+            k.flags_ = KeyFlag_VirtualKeyOnly;
             return k;
         }
 
-        LONG lParam = k.code_;
         switch (virtualKey)
         {
         case VK_LEFT: case VK_UP: case VK_RIGHT: case VK_DOWN:
@@ -127,22 +210,54 @@ namespace FakeInput
         case VK_END: case VK_HOME:
         case VK_INSERT: case VK_DELETE:
         case VK_DIVIDE: case VK_NUMLOCK:
-            lParam |= 0x100; // set extended bit
+        case VK_RCONTROL: case VK_RMENU:
+        case VK_LWIN: case VK_RWIN: case VK_APPS:
+        case VK_SNAPSHOT:
+            k.flags_ = KeyFlag_Extended;
             break;
         }
 
-        char name[129]{};
-        if (GetKeyNameTextA(lParam << 16, name, 128)) {
-            k.name_ = std::string(name);
+        return k;
+    }
+
+    /** Gets human readable name of the key.
+     *
+     * Names are resolved by the system on the first request and kept
+     * in a side table, keys themselves carry no name.
+     */
+    inline std::string keyName(Key key)
+    {
+        if (key.virtualKey_ == 0) {
+            return "<no key>";
         }
-        else {
-            k.name_ = "<unknown>";
+        if (key.flags_ & KeyFlag_VirtualKeyOnly) {
+            return "<virtual key only>";
         }
 
-        return k;
+        // one slot per scancode, the second half for extended scancodes
+        static std::vector<std::string> names(512);
+        static std::mutex namesMutex;
+
+        std::size_t slot = (key.code_ & 0xFF) | ((key.flags_ & KeyFlag_Extended) ? 0x100 : 0);
+
+        std::lock_guard<std::mutex> lock(namesMutex);
+        std::string& name = names[slot];
+        if (name.empty()) {
+            LONG lParam = static_cast<LONG>(slot); // extended bit is 0x100
+            char buffer[129]{};
+            if (GetKeyNameTextA(lParam << 16, buffer, 128)) {
+                name = buffer;
+            }
+            else {
+                name = "<unknown>";
+            }
+        }
+
+        return name;
     }
 
-    auto CreateKeyFromKeyType(KeyType type) -> Key
+    /** Resolves key of the key type through the system, bypassing KeyCache. */
+    inline auto resolveKeyFromKeyType(KeyType type) -> Key
     {
         if (type == Key_NoKey)
         {
@@ -151,8 +266,65 @@ namespace FakeInput
         else
         {
             auto virtualKey = (WORD)translateKey(type);
-            return CreateKeyFromKeycode(virtualKey);
+            Key k = resolveKeyFromKeycode(virtualKey);
+            if (type == Key_NumpadEnter) {
+                k.flags_ |= KeyFlag_Extended; // shares VK_RETURN with the main Enter key
+            }
+            return k;
+        }
+    }
+
+    struct KeyResolver
+    {
+        static bool beginRebuild()
+        {
+            return true;
+        }
+
+        static Key fromKeyType(KeyType type)
+        {
+            return resolveKeyFromKeyType(type);
+        }
+
+        static Key fromKeycode(std::uint32_t virtualKey)
+        {
+            return resolveKeyFromKeycode(static_cast<WORD>(virtualKey));
+        }
+    };
+
+    /** Keys precomputed for the keyboard layout of the first lookup.
+     *
+     * Keys are resolved with the layout of the thread which (re)builds
+     * the cache. Call KeyCache::invalidate() or refreshKeyCache() when
+     * the layout changes.
+     */
+    using KeyCache = KeyCache_base<KeyResolver>;
+
+    inline auto CreateKeyFromKeycode(WORD virtualKey) -> Key
+    {
+        return KeyCache::fromKeycode(virtualKey);
+    }
+
+    inline auto CreateKeyFromKeyType(KeyType type) -> Key
+    {
+        return KeyCache::fromKeyType(type);
+    }
+
+    /** Invalidates KeyCache if the message announces keyboard layout change.
+     *
+     * @param message
+     *      Message received by the window procedure or message loop.
+     *
+     * @returns whether the cache was invalidated.
+     */
+    inline bool refreshKeyCache(const MSG* message)
+    {
+        if (message->message != WM_INPUTLANGCHANGE) {
+            return false;
         }
+
+        KeyCache::invalidate();
+        return true;
     }
 
     auto CreateKeyFromMessage(MSG* message)
@@ -170,7 +342,7 @@ namespace FakeInput
             throw std::logic_error("Cannot get key from non-key message");
             break;
         }
-        return CreateKeyFromKeycode(tempVk);
+        return CreateKeyFromKeycode(static_cast<WORD>(tempVk));
     }
 
 }
@@ -28,32 +28,30 @@
 #include "config.hpp"
 
 #ifdef WIN32
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#include <Windows.h>
 #include "key_win.hpp"
 #endif
 
 #ifdef UNIX
-#include <X11/Xlib.h>
-#include <X11/extensions/XTest.h>
-#include "display_unix.hpp"
 #include "key_unix.hpp"
 #endif
 
-#include <iostream>
+#include <cstddef>
+#include <string_view>
+#include "backend.hpp"
+#include "event.hpp"
+#include "text.hpp"
 
 namespace FakeInput
 {
     /** Represents keyboard device.
      *
      * Allows you to simulate key press.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
      */
-    class Keyboard
+    template<typename Backend_t>
+    class Keyboard_base
     {
     public:
 
@@ -67,6 +65,19 @@ namespace FakeInput
             sendKeyEvent_(key, false);
         }
 
+        /** Types UTF-8 text with a single submission.
+         *
+         * Compiles a TextPlan_base on every call, keep the plan and submit
+         * it again to type the same text repeatedly.
+         *
+         * @returns number of events the backend accepted.
+         */
+        static std::size_t typeText(std::string_view utf8)
+        {
+            TextPlan_base<Backend_t> plan(utf8);
+            return plan.empty() ? 0 : Backend_t::submit(plan.events().data(), plan.size());
+        }
+
     private:
         /** Send fake key event to the system.
          *
@@ -75,50 +86,17 @@ namespace FakeInput
          * @param isPress
          *      Whether event is press or release.
          */
-#ifdef WIN32
         static void sendKeyEvent_(Key key, bool isPress)
         {
-            if (key.virtualKey_ == 0) {
-                std::cerr << "Cannot send <no key> event" << std::endl;
-                return;
-            }
+            InputEvent event{};
+            event.type = isPress ? Event_KeyPress : Event_KeyRelease;
+            event.key = key;
 
-            INPUT input{};
-            input.type = INPUT_KEYBOARD;
-
-            // Fallback logic: use scan code if valid, otherwise use virtual key
-            if (key.code_ != 0) {
-                input.ki.wScan = key.code_;
-                input.ki.dwFlags = KEYEVENTF_SCANCODE;
-            }
-            else {
-                input.ki.wVk = key.virtualKey_;
-                input.ki.dwFlags = 0; // fallback to virtual key
-            }
-
-            if (!isPress) {
-                input.ki.dwFlags |= KEYEVENTF_KEYUP;
-            }
-
-            ::SendInput(1, &input, sizeof(INPUT));
-        }
-
-#endif
-#ifdef UNIX
-        void sendKeyEvent_(Key key, bool isPress)
-        {
-            if (key.keysym() == NoSymbol)
-            {
-                std::cerr << "Cannot send <no key> event" << std::endl;
-            }
-            else
-            {
-                XTestFakeKeyEvent(display(), key.code(), isPress, CurrentTime);
-                XFlush(display());
-            }
+            Backend_t::submit(&event, 1);
         }
-#endif
     };
+
+    using Keyboard = Keyboard_base<SystemBackend>;
 }
 
 #endif
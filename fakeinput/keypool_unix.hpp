@@ -0,0 +1,382 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_KEYPOOL_UNIX_HPP
+#define FI_KEYPOOL_UNIX_HPP
+
+#include "config.hpp"
+#ifdef UNIX
+
+#include <X11/Xlib.h>
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "display_unix.hpp"
+#include "key_unix.hpp"
+
+namespace FakeInput
+{
+    /** Spare keycodes lent out to key symbols missing in the keyboard mapping.
+     *
+     * Spare keycodes are those without any key symbol when the pool is
+     * first used. Key symbols are bound to them with XChangeKeyboardMapping,
+     * a bound key symbol keeps its keycode until it becomes the least
+     * recently used one and another key symbol needs a keycode. All
+     * bindings of one bind() call are sent as one request per run of
+     * adjacent keycodes, followed by a single XSync and KeyCache::invalidate().
+     * The original empty mapping is restored by restore() and when the
+     * process exits.
+     *
+     * @warning @image html tux.png
+     *    Unix-like platform only
+     */
+    class KeycodePool
+    {
+    public:
+        /** Binds key symbols to keycodes.
+         *
+         * Key symbols already bound keep their keycodes, the others take
+         * the least recently used keycodes not needed by this call.
+         *
+         * @param keysyms
+         *      Key symbols to bind, may repeat.
+         * @param count
+         *      Number of key symbols.
+         * @param keycodes
+         *      Receives keycode of each key symbol, 0 if the pool ran out.
+         *
+         * @returns number of key symbols bound.
+         */
+        static std::size_t bind(const KeySym* keysyms, std::size_t count, std::uint8_t* keycodes)
+        {
+            Pool_& pool = pool_();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            Display* dpy = display();
+            if (!dpy || !load_(pool, dpy))
+            {
+                return 0;
+            }
+
+            std::uint64_t now = ++pool.clock;
+
+            // keep what is bound already, so it is not taken by the misses below
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                Slot_* slot = find_(pool, keysyms[i]);
+                if (slot)
+                {
+                    slot->lastUse = now;
+                }
+                keycodes[i] = slot ? slot->keycode : 0;
+            }
+
+            std::size_t bound = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (keycodes[i] == 0)
+                {
+                    Slot_* slot = find_(pool, keysyms[i]); // repeated key symbol bound just now
+                    if (!slot)
+                    {
+                        slot = leastRecentlyUsed_(pool, now);
+                        if (!slot)
+                        {
+                            continue;
+                        }
+
+                        slot->keysym = keysyms[i];
+                        slot->isDirty = true;
+                    }
+
+                    slot->lastUse = now;
+                    keycodes[i] = slot->keycode;
+                }
+                ++bound;
+            }
+
+            if (write_(pool, dpy))
+            {
+                XSync(dpy, False);
+                KeyCache::invalidate();
+            }
+
+            return bound;
+        }
+
+        /** Binds one key symbol, see bind().
+         *
+         * @returns keycode or 0 if the pool is empty.
+         */
+        static std::uint8_t bind(KeySym keysym)
+        {
+            std::uint8_t keycode = 0;
+            bind(&keysym, 1, &keycode);
+            return keycode;
+        }
+
+        /** Whether the keycode belongs to the pool. */
+        static bool owns(std::uint8_t keycode)
+        {
+            Pool_& pool = pool_();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            Display* dpy = display();
+            if (!dpy || !load_(pool, dpy))
+            {
+                return false;
+            }
+
+            for (const Slot_& slot : pool.slots)
+            {
+                if (slot.keycode == keycode)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /** Keycodes of the pool, taken with a single lock.
+         *
+         * Use it instead of owns() when checking many keycodes.
+         */
+        static std::bitset<256> owned()
+        {
+            Pool_& pool = pool_();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            std::bitset<256> keycodes;
+            Display* dpy = display();
+            if (dpy && load_(pool, dpy))
+            {
+                for (const Slot_& slot : pool.slots)
+                {
+                    keycodes.set(slot.keycode);
+                }
+            }
+
+            return keycodes;
+        }
+
+        /** Number of spare keycodes. */
+        static std::size_t capacity()
+        {
+            Pool_& pool = pool_();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            Display* dpy = display();
+            return dpy && load_(pool, dpy) ? pool.slots.size() : 0;
+        }
+
+        /** Unbinds all key symbols, keycodes get their empty mapping back. */
+        static void restore()
+        {
+            Pool_& pool = pool_();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+
+            Display* dpy = display();
+            if (dpy && unbindAll_(pool, dpy))
+            {
+                XSync(dpy, False);
+                KeyCache::invalidate();
+            }
+        }
+
+    private:
+        struct Slot_
+        {
+            std::uint8_t keycode;
+            KeySym keysym; // NoSymbol when free
+            std::uint64_t lastUse;
+            bool isDirty; // mapping not sent yet
+        };
+
+        struct Pool_
+        {
+            std::mutex mutex;
+            bool isLoaded = false;
+            std::vector<Slot_> slots; // ordered by keycode
+            std::uint64_t clock = 0;
+
+            ~Pool_()
+            {
+                // the thread's connection may be closed already
+                std::lock_guard<std::mutex> lock(mutex);
+                bool isBound = false;
+                for (const Slot_& slot : slots)
+                {
+                    isBound = isBound || slot.keysym != NoSymbol;
+                }
+                if (!isBound)
+                {
+                    return;
+                }
+
+                Display* dpy = XOpenDisplay(nullptr);
+                if (dpy)
+                {
+                    unbindAll_(*this, dpy);
+                    XCloseDisplay(dpy); // flushes
+                }
+            }
+        };
+
+        static Pool_& pool_()
+        {
+            static Pool_ pool;
+            return pool;
+        }
+
+        /** Collects keycodes without any key symbol, once. */
+        static bool load_(Pool_& pool, Display* dpy)
+        {
+            if (pool.isLoaded)
+            {
+                return true;
+            }
+
+            int minKeycode = 0;
+            int maxKeycode = 0;
+            XDisplayKeycodes(dpy, &minKeycode, &maxKeycode);
+
+            int perKeycode = 0;
+            int count = maxKeycode - minKeycode + 1;
+            KeySym* keysyms = XGetKeyboardMapping(dpy, static_cast<KeyCode>(minKeycode), count, &perKeycode);
+            if (!keysyms)
+            {
+                return false;
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                bool isSpare = true;
+                for (int level = 0; level < perKeycode; ++level)
+                {
+                    isSpare = isSpare && keysyms[i * perKeycode + level] == NoSymbol;
+                }
+
+                if (isSpare)
+                {
+                    pool.slots.push_back(Slot_{ static_cast<std::uint8_t>(minKeycode + i), NoSymbol, 0, false });
+                }
+            }
+
+            XFree(keysyms);
+            pool.isLoaded = true;
+            return true;
+        }
+
+        static Slot_* find_(Pool_& pool, KeySym keysym)
+        {
+            for (Slot_& slot : pool.slots)
+            {
+                if (slot.keysym == keysym)
+                {
+                    return &slot;
+                }
+            }
+
+            return nullptr;
+        }
+
+        /** Free slot or the one used longest ago, none used at now. */
+        static Slot_* leastRecentlyUsed_(Pool_& pool, std::uint64_t now)
+        {
+            Slot_* oldest = nullptr;
+            for (Slot_& slot : pool.slots)
+            {
+                if (slot.lastUse != now && (!oldest || slot.lastUse < oldest->lastUse))
+                {
+                    oldest = &slot;
+                }
+            }
+
+            return oldest;
+        }
+
+        static bool unbindAll_(Pool_& pool, Display* dpy)
+        {
+            for (Slot_& slot : pool.slots)
+            {
+                if (slot.keysym != NoSymbol)
+                {
+                    slot.keysym = NoSymbol;
+                    slot.lastUse = 0;
+                    slot.isDirty = true;
+                }
+            }
+
+            return write_(pool, dpy);
+        }
+
+        /** Sends dirty slots, one request per run of adjacent keycodes.
+         *
+         * @returns whether anything was sent.
+         */
+        static bool write_(Pool_& pool, Display* dpy)
+        {
+            std::vector<KeySym> run;
+            std::uint8_t first = 0;
+            bool isWritten = false;
+
+            for (std::size_t i = 0; i <= pool.slots.size(); ++i)
+            {
+                Slot_* slot = i < pool.slots.size() ? &pool.slots[i] : nullptr;
+                bool continues = slot && slot->isDirty && !run.empty()
+                    && slot->keycode == first + run.size() / 2;
+
+                if (!run.empty() && !continues)
+                {
+                    XChangeKeyboardMapping(dpy, first, 2, run.data(), static_cast<int>(run.size() / 2));
+                    run.clear();
+                    isWritten = true;
+                }
+
+                if (slot && slot->isDirty)
+                {
+                    if (run.empty())
+                    {
+                        first = slot->keycode;
+                    }
+
+                    // the same key symbol on both shift levels
+                    run.push_back(slot->keysym);
+                    run.push_back(slot->keysym);
+                    slot->isDirty = false;
+                }
+            }
+
+            return isWritten;
+        }
+    };
+}
+
+#endif
+#endif
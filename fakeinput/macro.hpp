@@ -0,0 +1,830 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_MACRO_HPP
+#define FI_MACRO_HPP
+
+#include "config.hpp"
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
+#include "system.hpp"
+#include "types.hpp"
+
+/* Macro file layout, all integers little endian:
+ *
+ *   header    "FIMC", version byte, platform byte, 2 reserved bytes
+ *   code      instructions up to MacroOp_End
+ *
+ * An event instruction is its EventType as the opcode byte, the delay
+ * before the event in microseconds as varint and the operands: key
+ * events carry the Key handle (virtual key and code as varints, flags
+ * byte), button events the button byte, other events x and y as zigzag
+ * varints. Key handles are platform specific, so the header names the
+ * platform the macro was written on.
+ */
+
+namespace FakeInput
+{
+    /** Current version of the macro format */
+    constexpr std::uint8_t MacroVersion = 1;
+
+    /** Size of the macro header in bytes */
+    constexpr std::size_t MacroHeaderSize = 8;
+
+    /** Platform whose key handles a macro contains */
+    enum MacroPlatform : std::uint8_t
+    {
+        MacroPlatform_Windows = 1,
+        MacroPlatform_X11 = 2
+    };
+
+#ifdef WIN32
+    constexpr MacroPlatform CurrentMacroPlatform = MacroPlatform_Windows;
+#endif
+#ifdef UNIX
+    constexpr MacroPlatform CurrentMacroPlatform = MacroPlatform_X11;
+#endif
+
+    /** Opcodes which are not events, event opcodes equal their EventType */
+    enum MacroOp : std::uint8_t
+    {
+        MacroOp_End = 0,
+        MacroOp_Wait = 0x40, // varint microseconds, added to the next event's delay
+        MacroOp_Jump = 0x41, // 32 bit offset from the end of the instruction
+        MacroOp_Repeat = 0x42 // varint count (0 is forever), 32 bit offset from the end of the instruction
+    };
+
+    /** Builds macro code in memory.
+     *
+     * Mirrors InputBatch, plus labels which jump() and repeat() go back
+     * or forward to.
+     */
+    class MacroWriter
+    {
+    public:
+        /** Position in the code, see label(). */
+        struct Label
+        {
+            std::size_t offset;
+        };
+
+        MacroWriter()
+        {
+            const std::uint8_t header[MacroHeaderSize] = { 'F', 'I', 'M', 'C', MacroVersion, CurrentMacroPlatform, 0, 0 };
+            code_.assign(header, header + MacroHeaderSize);
+        }
+
+        MacroWriter& pressKey(Key key)
+        {
+            return addKeyEvent_(key, Event_KeyPress);
+        }
+
+        MacroWriter& releaseKey(Key key)
+        {
+            return addKeyEvent_(key, Event_KeyRelease);
+        }
+
+        MacroWriter& pressButton(MouseButton button)
+        {
+            return addButtonEvent_(button, Event_ButtonPress);
+        }
+
+        MacroWriter& releaseButton(MouseButton button)
+        {
+            return addButtonEvent_(button, Event_ButtonRelease);
+        }
+
+        MacroWriter& move(int dx, int dy)
+        {
+            return addPointerEvent_(Event_Move, dx, dy);
+        }
+
+        MacroWriter& moveTo(int x, int y)
+        {
+            return addPointerEvent_(Event_MoveTo, x, y);
+        }
+
+        MacroWriter& wheelUp()
+        {
+            return addPointerEvent_(Event_Wheel, 0, 1);
+        }
+
+        MacroWriter& wheelDown()
+        {
+            return addPointerEvent_(Event_Wheel, 0, -1);
+        }
+
+        /** Delays the next event.
+         *
+         * @param milisec
+         *      time to wait in miliseconds
+         */
+        MacroWriter& wait(unsigned int milisec)
+        {
+            return waitMicroseconds(std::uint64_t(milisec) * 1000);
+        }
+
+        MacroWriter& waitMicroseconds(std::uint64_t microsec)
+        {
+            pendingDelay_ += microsec;
+            return *this;
+        }
+
+        /** Appends event, its delay is in miliseconds like in InputBatch. */
+        MacroWriter& add(const InputEvent& event)
+        {
+            if (event.type == Event_None)
+            {
+                return *this;
+            }
+
+            std::uint64_t delay = pendingDelay_ + std::uint64_t(event.delay) * 1000;
+            pendingDelay_ = 0;
+
+            code_.push_back(static_cast<std::uint8_t>(event.type));
+            putVarint_(delay);
+
+            switch (event.type)
+            {
+            case Event_KeyPress:
+            case Event_KeyRelease:
+                putVarint_(event.key.virtualKey_);
+                putVarint_(event.key.code_);
+                code_.push_back(event.key.flags_);
+                break;
+            case Event_ButtonPress:
+            case Event_ButtonRelease:
+                code_.push_back(static_cast<std::uint8_t>(event.button));
+                break;
+            default:
+                putVarint_(zigzag_(event.x));
+                putVarint_(zigzag_(event.y));
+                break;
+            }
+
+            return *this;
+        }
+
+        /** Marks the current position, pending wait stays before it. */
+        Label label()
+        {
+            flushWait_();
+            return Label{ written_ + code_.size() };
+        }
+
+        /** Continues at the label. */
+        MacroWriter& jump(Label target)
+        {
+            flushWait_();
+            code_.push_back(MacroOp_Jump);
+            putOffset_(target);
+            return *this;
+        }
+
+        /** Runs the code from the label up to here count times in total.
+         *
+         * Repeats must nest and may not be jumped out of.
+         *
+         * @param count
+         *      Number of runs, 0 repeats until MacroPlayer::stop().
+         */
+        MacroWriter& repeat(Label target, std::uint64_t count)
+        {
+            flushWait_();
+            code_.push_back(MacroOp_Repeat);
+            putVarint_(count);
+            putOffset_(target);
+            return *this;
+        }
+
+        /** Terminates the code, a wait at the end is dropped.
+         *
+         * @returns complete macro, without the part passed to writeTo().
+         */
+        const std::vector<std::uint8_t>& finish()
+        {
+            pendingDelay_ = 0;
+            if (!isFinished_)
+            {
+                code_.push_back(MacroOp_End);
+                isFinished_ = true;
+            }
+            return code_;
+        }
+
+        /** Finishes the macro and writes it to the file.
+         *
+         * @returns false if the file cannot be written.
+         */
+        bool save(const std::string& path)
+        {
+            const std::vector<std::uint8_t>& code = finish();
+
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if (!file)
+            {
+                std::cerr << "Cannot open macro file " << path << std::endl;
+                return false;
+            }
+
+            bool isWritten = std::fwrite(code.data(), 1, code.size(), file) == code.size();
+            return std::fclose(file) == 0 && isWritten;
+        }
+
+        /** Appends the code built so far to the file and drops it from memory.
+         *
+         * Lets a long macro be streamed out while it is built. Labels
+         * stay valid, jumps are relative.
+         *
+         * @returns false if the file cannot be written.
+         */
+        bool writeTo(std::FILE* file)
+        {
+            bool isWritten = std::fwrite(code_.data(), 1, code_.size(), file) == code_.size();
+            written_ += code_.size();
+            code_.clear();
+            return isWritten;
+        }
+
+    private:
+        MacroWriter& addKeyEvent_(Key key, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.key = key;
+            return add(event);
+        }
+
+        MacroWriter& addButtonEvent_(MouseButton button, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.button = button;
+            return add(event);
+        }
+
+        MacroWriter& addPointerEvent_(EventType type, int x, int y)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.x = x;
+            event.y = y;
+            return add(event);
+        }
+
+        void flushWait_()
+        {
+            if (pendingDelay_ > 0)
+            {
+                code_.push_back(MacroOp_Wait);
+                putVarint_(pendingDelay_);
+                pendingDelay_ = 0;
+            }
+        }
+
+        static std::uint64_t zigzag_(int value)
+        {
+            return (static_cast<std::uint64_t>(static_cast<std::int64_t>(value)) << 1) ^ static_cast<std::uint64_t>(static_cast<std::int64_t>(value) >> 63);
+        }
+
+        void putVarint_(std::uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                code_.push_back(static_cast<std::uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            code_.push_back(static_cast<std::uint8_t>(value));
+        }
+
+        /** Offset from the end of the instruction, which is the end of the offset. */
+        void putOffset_(Label target)
+        {
+            std::int64_t offset = static_cast<std::int64_t>(target.offset) - static_cast<std::int64_t>(written_ + code_.size() + 4);
+            std::uint32_t bits = static_cast<std::uint32_t>(static_cast<std::int32_t>(offset));
+            for (int i = 0; i < 4; ++i)
+            {
+                code_.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+            }
+        }
+
+        std::vector<std::uint8_t> code_; // not written out yet
+        std::size_t written_ = 0; // bytes passed to writeTo()
+        std::uint64_t pendingDelay_ = 0;
+        bool isFinished_ = false;
+    };
+
+    /** Read-only memory mapping of a macro file.
+     *
+     * Pages are loaded on demand, opening a file does not read it.
+     */
+    class MacroFile
+    {
+    public:
+        MacroFile() = default;
+
+        explicit MacroFile(const std::string& path)
+        {
+            open(path);
+        }
+
+        ~MacroFile()
+        {
+            close();
+        }
+
+        MacroFile(const MacroFile&) = delete;
+        MacroFile& operator=(const MacroFile&) = delete;
+
+        /** Maps the file, replacing the current mapping.
+         *
+         * @returns false if the file cannot be mapped.
+         */
+        bool open(const std::string& path)
+        {
+            close();
+
+#ifdef WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+
+            LARGE_INTEGER size{};
+            HANDLE mapping = nullptr;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            }
+            CloseHandle(file); // the mapping keeps the file open
+
+            if (!mapping) {
+                return false;
+            }
+
+            data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping); // the view keeps the mapping alive
+            size_ = data_ ? static_cast<std::size_t>(size.QuadPart) : 0;
+#endif
+
+#ifdef UNIX
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            struct stat info{};
+            void* data = MAP_FAILED;
+            if (fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd); // the mapping keeps the file open
+
+            if (data == MAP_FAILED)
+            {
+                return false;
+            }
+
+            data_ = static_cast<const std::uint8_t*>(data);
+            size_ = static_cast<std::size_t>(info.st_size);
+#endif
+
+            return data_ != nullptr;
+        }
+
+        void close()
+        {
+            if (!data_)
+            {
+                return;
+            }
+
+#ifdef WIN32
+            UnmapViewOfFile(data_);
+#endif
+#ifdef UNIX
+            munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        bool isOpen() const
+        {
+            return data_ != nullptr;
+        }
+
+        const std::uint8_t* data() const
+        {
+            return data_;
+        }
+
+        std::size_t size() const
+        {
+            return size_;
+        }
+
+    private:
+        const std::uint8_t* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    /** Executes macro code.
+     *
+     * The code is interpreted in place, playing allocates nothing. Event
+     * delays accumulate into absolute deadlines, so long and looping
+     * macros do not drift, and events due at the same time are submitted
+     * together with one system call.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class MacroPlayer_base
+    {
+    public:
+        /** Maximal nesting of repeats */
+        static constexpr std::size_t MaxRepeatDepth = 16;
+
+        /** Maximal number of events submitted at once */
+        static constexpr std::size_t BurstCapacity = 64;
+
+        /** Creates player.
+         *
+         * @param spinThreshold
+         *      Nanoseconds before a deadline at which sleeping switches to busy-waiting.
+         */
+        explicit MacroPlayer_base(std::int64_t spinThreshold = DefaultSpinThreshold)
+            : spinThreshold_(spinThreshold)
+        {
+        }
+
+        MacroPlayer_base(const MacroPlayer_base&) = delete;
+        MacroPlayer_base& operator=(const MacroPlayer_base&) = delete;
+
+        std::size_t play(const MacroFile& file)
+        {
+            return play(file.data(), file.size());
+        }
+
+        std::size_t play(const std::vector<std::uint8_t>& macro)
+        {
+            return play(macro.data(), macro.size());
+        }
+
+        /** Plays the macro, blocking until it ends or stop() is called.
+         *
+         * Malformed code is played up to the first bad instruction. Waits
+         * pending at a jump back are slept there, and a forever loop which
+         * neither sends an event nor waits ends the playback instead of
+         * spinning.
+         *
+         * @returns number of events the system accepted.
+         */
+        std::size_t play(const std::uint8_t* macro, std::size_t size)
+        {
+            stop_.store(false, std::memory_order_relaxed);
+
+            if (!checkHeader_(macro, size))
+            {
+                return 0;
+            }
+
+            const std::uint8_t* begin = macro + MacroHeaderSize;
+            const std::uint8_t* end = macro + size;
+            const std::uint8_t* pc = begin;
+
+            std::size_t sent = 0;
+            std::size_t depth = 0;
+            std::uint64_t delay = 0;
+            std::int64_t deadline = monotonicTime();
+            burstSize_ = 0;
+
+            std::uint64_t progress = 0; // events and sleeps so far
+            const std::uint8_t* foreverLoop = nullptr; // last forever jump taken
+            std::uint64_t foreverProgress = 0;
+
+            // a pass of a loop ends, @returns false if it is a forever loop
+            // whose pass did nothing
+            auto closeLoop = [&](const std::uint8_t* instruction, bool isForever) {
+                if (delay > 0)
+                {
+                    sent += submit_();
+                    deadline += static_cast<std::int64_t>(delay) * 1000;
+                    delay = 0;
+                    sleepUntil(deadline, spinThreshold_);
+                    ++progress;
+                }
+                if (!isForever)
+                {
+                    return true;
+                }
+                if (instruction == foreverLoop && progress == foreverProgress)
+                {
+                    return false;
+                }
+                foreverLoop = instruction;
+                foreverProgress = progress;
+                return true;
+            };
+
+            while (!stop_.load(std::memory_order_relaxed))
+            {
+                if (pc == end)
+                {
+                    return sent + fail_("code is not terminated");
+                }
+
+                const std::uint8_t* instruction = pc;
+                std::uint8_t op = *pc++;
+
+                if (op >= Event_KeyPress && op <= Event_UnicodeRelease)
+                {
+                    InputEvent event{};
+                    event.type = static_cast<EventType>(op);
+
+                    std::uint64_t eventDelay = 0;
+                    if (!readVarint_(pc, end, eventDelay) || !readOperands_(pc, end, event))
+                    {
+                        return sent + submit_() + fail_("truncated event");
+                    }
+
+                    delay += eventDelay;
+                    if (delay > 0)
+                    {
+                        sent += submit_();
+                        deadline += static_cast<std::int64_t>(delay) * 1000;
+                        delay = 0;
+                        sleepUntil(deadline, spinThreshold_);
+                    }
+
+                    burst_[burstSize_++] = event;
+                    ++progress;
+                    if (burstSize_ == BurstCapacity)
+                    {
+                        sent += submit_();
+                    }
+                    continue;
+                }
+
+                switch (op)
+                {
+                case MacroOp_End:
+                    return sent + submit_();
+                case MacroOp_Wait:
+                {
+                    std::uint64_t wait = 0;
+                    if (!readVarint_(pc, end, wait))
+                    {
+                        return sent + submit_() + fail_("truncated wait");
+                    }
+                    delay += wait;
+                    break;
+                }
+                case MacroOp_Jump:
+                {
+                    const std::uint8_t* target = nullptr;
+                    if (!readTarget_(pc, begin, end, target))
+                    {
+                        return sent + submit_() + fail_("bad jump");
+                    }
+                    if (target <= instruction && !closeLoop(instruction, true))
+                    {
+                        return sent + submit_() + fail_("loop without events or waits");
+                    }
+                    pc = target;
+                    break;
+                }
+                case MacroOp_Repeat:
+                {
+                    std::uint64_t count = 0;
+                    const std::uint8_t* target = nullptr;
+                    if (!readVarint_(pc, end, count) || !readTarget_(pc, begin, end, target))
+                    {
+                        return sent + submit_() + fail_("bad repeat");
+                    }
+
+                    if (count == 0)
+                    {
+                        if (!closeLoop(instruction, true))
+                        {
+                            return sent + submit_() + fail_("loop without events or waits");
+                        }
+                        pc = target; // forever
+                        break;
+                    }
+
+                    if (depth == 0 || repeats_[depth - 1].instruction != instruction)
+                    {
+                        if (depth == MaxRepeatDepth)
+                        {
+                            return sent + submit_() + fail_("repeats nested too deep");
+                        }
+                        repeats_[depth++] = Repeat_{ instruction, count };
+                    }
+
+                    if (--repeats_[depth - 1].remaining == 0)
+                    {
+                        --depth;
+                    }
+                    else
+                    {
+                        closeLoop(instruction, false);
+                        pc = target;
+                    }
+                    break;
+                }
+                default:
+                    return sent + submit_() + fail_("unknown instruction");
+                }
+            }
+
+            return sent + submit_();
+        }
+
+        /** Makes play() return before the next instruction, callable from any thread. */
+        void stop()
+        {
+            stop_.store(true, std::memory_order_relaxed);
+        }
+
+    private:
+        struct Repeat_
+        {
+            const std::uint8_t* instruction;
+            std::uint64_t remaining; // runs left including the current one
+        };
+
+        static bool checkHeader_(const std::uint8_t* macro, std::size_t size)
+        {
+            if (!macro || size < MacroHeaderSize || macro[0] != 'F' || macro[1] != 'I' || macro[2] != 'M' || macro[3] != 'C')
+            {
+                fail_("not a macro");
+                return false;
+            }
+            if (macro[4] != MacroVersion)
+            {
+                fail_("unsupported version");
+                return false;
+            }
+            if (macro[5] != CurrentMacroPlatform)
+            {
+                fail_("recorded on another platform");
+                return false;
+            }
+
+            return true;
+        }
+
+        static std::size_t fail_(const char* reason)
+        {
+            std::cerr << "Cannot play macro: " << reason << std::endl;
+            return 0;
+        }
+
+        static bool readVarint_(const std::uint8_t*& pc, const std::uint8_t* end, std::uint64_t& value)
+        {
+            value = 0;
+            for (unsigned shift = 0; pc != end && shift < 64; shift += 7)
+            {
+                std::uint8_t byte = *pc++;
+                value |= std::uint64_t(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        static bool readSigned_(const std::uint8_t*& pc, const std::uint8_t* end, int& value)
+        {
+            std::uint64_t zigzag = 0;
+            if (!readVarint_(pc, end, zigzag))
+            {
+                return false;
+            }
+
+            value = static_cast<int>(static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1));
+            return true;
+        }
+
+        static bool readTarget_(const std::uint8_t*& pc, const std::uint8_t* begin, const std::uint8_t* end, const std::uint8_t*& target)
+        {
+            if (end - pc < 4)
+            {
+                return false;
+            }
+
+            std::uint32_t bits = std::uint32_t(pc[0]) | std::uint32_t(pc[1]) << 8 | std::uint32_t(pc[2]) << 16 | std::uint32_t(pc[3]) << 24;
+            pc += 4;
+
+            std::int64_t offset = static_cast<std::int32_t>(bits);
+            if (offset < begin - pc || offset >= end - pc)
+            {
+                return false;
+            }
+
+            target = pc + offset;
+            return true;
+        }
+
+        static bool readOperands_(const std::uint8_t*& pc, const std::uint8_t* end, InputEvent& event)
+        {
+            switch (event.type)
+            {
+            case Event_KeyPress:
+            case Event_KeyRelease:
+            {
+                std::uint64_t virtualKey = 0;
+                std::uint64_t code = 0;
+                if (!readVarint_(pc, end, virtualKey) || !readVarint_(pc, end, code) || pc == end)
+                {
+                    return false;
+                }
+
+                event.key.virtualKey_ = static_cast<decltype(event.key.virtualKey_)>(virtualKey);
+                event.key.code_ = static_cast<decltype(event.key.code_)>(code);
+                event.key.flags_ = *pc++;
+                return true;
+            }
+            case Event_ButtonPress:
+            case Event_ButtonRelease:
+                if (pc == end || *pc >= MouseButtonCount)
+                {
+                    return false;
+                }
+                event.button = static_cast<MouseButton>(*pc++);
+                return true;
+            default:
+                return readSigned_(pc, end, event.x) && readSigned_(pc, end, event.y);
+            }
+        }
+
+        std::size_t submit_()
+        {
+            std::size_t sent = burstSize_ > 0 ? Backend_t::submit(burst_, burstSize_) : 0;
+            burstSize_ = 0;
+            return sent;
+        }
+
+        std::int64_t spinThreshold_;
+        std::atomic<bool> stop_{ false };
+        InputEvent burst_[BurstCapacity];
+        std::size_t burstSize_ = 0;
+        Repeat_ repeats_[MaxRepeatDepth];
+    };
+
+    using MacroPlayer = MacroPlayer_base<SystemBackend>;
+}
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_METRICS_HPP
+#define FI_METRICS_HPP
+
+#include "config.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#ifdef FAKEINPUT_METRICS
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "system.hpp"
+#endif
+
+namespace FakeInput
+{
+    /** Counters of Metrics */
+    enum MetricCounter
+    {
+        Metric_EventsSubmitted, // events handed to the system
+        Metric_EventsRejected, // events the system did not accept
+        Metric_Flushes, // SendInput calls or X connection flushes
+        Metric_Reconnects, // X connections opened again after an error
+        MetricCounterCount
+    };
+
+    /** Latency histograms of Metrics, values in nanoseconds */
+    enum MetricHistogram
+    {
+        Metric_EnqueueToSubmit, // from Injector::post() to the submission
+        Metric_SubmitDuration, // one SendInput call or XTest burst with its flush
+        MetricHistogramCount
+    };
+
+    /** Log-linear bucketing of nanosecond values.
+     *
+     * Values below SubBuckets have a bucket each, larger ones get
+     * SubBuckets buckets per power of two, so every value is kept with
+     * a relative error below 1 / SubBuckets.
+     */
+    struct LatencyBuckets
+    {
+        static constexpr unsigned SubBucketBits = 4;
+        static constexpr std::uint64_t SubBuckets = 1 << SubBucketBits;
+        static constexpr std::size_t Count = (64 - SubBucketBits + 1) * SubBuckets;
+
+        static constexpr std::size_t index(std::uint64_t value)
+        {
+            if (value < SubBuckets)
+            {
+                return static_cast<std::size_t>(value);
+            }
+
+            unsigned magnitude = 63;
+            while (!(value >> magnitude))
+            {
+                --magnitude;
+            }
+            std::uint64_t sub = (value >> (magnitude - SubBucketBits)) & (SubBuckets - 1);
+            return static_cast<std::size_t>((magnitude - SubBucketBits + 1) * SubBuckets + sub);
+        }
+
+        /** Lowest value falling into the bucket */
+        static constexpr std::uint64_t lowerBound(std::size_t bucket)
+        {
+            if (bucket < SubBuckets)
+            {
+                return bucket;
+            }
+
+            unsigned magnitude = static_cast<unsigned>(bucket / SubBuckets) + SubBucketBits - 1;
+            return (SubBuckets | (bucket % SubBuckets)) << (magnitude - SubBucketBits);
+        }
+    };
+
+    static_assert(LatencyBuckets::index(~std::uint64_t(0)) == LatencyBuckets::Count - 1,
+        "largest value must fall into the last bucket");
+    static_assert(LatencyBuckets::lowerBound(LatencyBuckets::index(1000)) <= 1000 && LatencyBuckets::lowerBound(LatencyBuckets::index(1000) + 1) > 1000,
+        "lowerBound must invert index");
+
+    /** Aggregated content of one histogram */
+    struct HistogramSnapshot
+    {
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t max = 0;
+        std::array<std::uint64_t, LatencyBuckets::Count> buckets{};
+
+        double mean() const
+        {
+            return count ? static_cast<double>(sum) / count : 0.0;
+        }
+
+        /** Value below which the given fraction of values lies.
+         *
+         * @param fraction
+         *      Between 0 and 1, e.g. 0.99 for the 99th percentile.
+         *
+         * @returns lower bound of the bucket holding the percentile,
+         * or the maximum for fraction 1.
+         */
+        std::uint64_t percentile(double fraction) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            if (fraction >= 1.0)
+            {
+                return max;
+            }
+
+            std::uint64_t rank = static_cast<std::uint64_t>(fraction * count);
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets.size(); ++i)
+            {
+                seen += buckets[i];
+                if (seen > rank)
+                {
+                    return LatencyBuckets::lowerBound(i);
+                }
+            }
+            return max;
+        }
+    };
+
+    /** Totals of all threads at the moment of Metrics::snapshot() */
+    struct MetricsSnapshot
+    {
+        std::array<std::uint64_t, MetricCounterCount> counters{};
+        std::array<HistogramSnapshot, MetricHistogramCount> histograms{};
+
+        std::uint64_t operator[](MetricCounter counter) const
+        {
+            return counters[counter];
+        }
+
+        const HistogramSnapshot& operator[](MetricHistogram histogram) const
+        {
+            return histograms[histogram];
+        }
+    };
+
+#ifdef FAKEINPUT_METRICS
+    constexpr bool MetricsEnabled = true;
+
+    /** Counters and histograms of the injection path.
+     *
+     * Every thread writes a block of its own with plain relaxed stores,
+     * no read-modify-write and no shared cache lines, so recording costs
+     * a few instructions. snapshot() sums the blocks of all threads.
+     * Blocks of exited threads are kept and reused by new threads, so
+     * the totals never go down.
+     *
+     * Enabled by defining FAKEINPUT_METRICS, see config.hpp. Otherwise
+     * every member is empty and the calls compile to nothing.
+     */
+    class Metrics
+    {
+    public:
+        static void count(MetricCounter counter, std::uint64_t n = 1)
+        {
+            add_(threadBlock_().counters[counter], n);
+        }
+
+        static void record(MetricHistogram histogram, std::int64_t nanoseconds)
+        {
+            std::uint64_t value = nanoseconds > 0 ? static_cast<std::uint64_t>(nanoseconds) : 0;
+            Histogram_& target = threadBlock_().histograms[histogram];
+
+            add_(target.buckets[LatencyBuckets::index(value)], 1);
+            add_(target.count, 1);
+            add_(target.sum, value);
+            if (value > target.max.load(std::memory_order_relaxed))
+            {
+                target.max.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        /** Timestamp to pass to record() later, monotonicTime() */
+        static std::int64_t now()
+        {
+            return monotonicTime();
+        }
+
+        /** Sums the values of all threads. */
+        static MetricsSnapshot snapshot()
+        {
+            MetricsSnapshot result;
+
+            std::lock_guard<std::mutex> lock(registry_().mutex);
+            for (const Block_* block : registry_().blocks)
+            {
+                for (std::size_t i = 0; i < MetricCounterCount; ++i)
+                {
+                    result.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+                }
+                for (std::size_t h = 0; h < MetricHistogramCount; ++h)
+                {
+                    const Histogram_& source = block->histograms[h];
+                    HistogramSnapshot& target = result.histograms[h];
+                    for (std::size_t i = 0; i < LatencyBuckets::Count; ++i)
+                    {
+                        target.buckets[i] += source.buckets[i].load(std::memory_order_relaxed);
+                    }
+                    target.count += source.count.load(std::memory_order_relaxed);
+                    target.sum += source.sum.load(std::memory_order_relaxed);
+                    target.max = std::max(target.max, source.max.load(std::memory_order_relaxed));
+                }
+            }
+            return result;
+        }
+
+    private:
+        struct Histogram_
+        {
+            std::atomic<std::uint64_t> buckets[LatencyBuckets::Count] = {};
+            std::atomic<std::uint64_t> count{ 0 };
+            std::atomic<std::uint64_t> sum{ 0 };
+            std::atomic<std::uint64_t> max{ 0 };
+        };
+
+        struct alignas(64) Block_
+        {
+            std::atomic<std::uint64_t> counters[MetricCounterCount] = {};
+            Histogram_ histograms[MetricHistogramCount];
+            bool isUsed = true; // guarded by the registry mutex
+        };
+
+        struct Registry_
+        {
+            std::mutex mutex;
+            std::vector<Block_*> blocks;
+        };
+
+        /** Returns block to the registry when its thread exits */
+        struct ThreadSlot_
+        {
+            Block_* block = nullptr;
+
+            ~ThreadSlot_()
+            {
+                if (block)
+                {
+                    std::lock_guard<std::mutex> lock(registry_().mutex);
+                    block->isUsed = false;
+                }
+            }
+        };
+
+        /** Only the owning thread writes, so a load and a store suffice */
+        static void add_(std::atomic<std::uint64_t>& value, std::uint64_t n)
+        {
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        static Block_& threadBlock_()
+        {
+            static thread_local ThreadSlot_ slot;
+            if (!slot.block)
+            {
+                slot.block = acquireBlock_();
+            }
+            return *slot.block;
+        }
+
+        static Block_* acquireBlock_()
+        {
+            Registry_& registry = registry_();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (Block_* block : registry.blocks)
+            {
+                if (!block->isUsed)
+                {
+                    block->isUsed = true;
+                    return block;
+                }
+            }
+
+            registry.blocks.push_back(new Block_);
+            return registry.blocks.back();
+        }
+
+        static Registry_& registry_()
+        {
+            // never destroyed, threads may record while the process exits
+            static Registry_* registry = new Registry_;
+            return *registry;
+        }
+    };
+#else
+    constexpr bool MetricsEnabled = false;
+
+    class Metrics
+    {
+    public:
+        static void count(MetricCounter, std::uint64_t = 1)
+        {
+        }
+
+        static void record(MetricHistogram, std::int64_t)
+        {
+        }
+
+        static std::int64_t now()
+        {
+            return 0;
+        }
+
+        /** @returns zeros, metrics are disabled. */
+        static MetricsSnapshot snapshot()
+        {
+            return MetricsSnapshot();
+        }
+    };
+#endif
+
+    /** Records the time until the end of the scope into a histogram */
+    class MetricsTimer
+    {
+    public:
+        explicit MetricsTimer(MetricHistogram histogram)
+            : histogram_(histogram), start_(Metrics::now())
+        {
+        }
+
+        MetricsTimer(const MetricsTimer&) = delete;
+        MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+        ~MetricsTimer()
+        {
+            if (MetricsEnabled)
+            {
+                Metrics::record(histogram_, Metrics::now() - start_);
+            }
+        }
+
+    private:
+        MetricHistogram histogram_;
+        std::int64_t start_;
+    };
+}
+
+#endif
@@ -27,156 +27,74 @@
 
 #include "config.hpp"
 
-#ifdef WIN32
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#include <Windows.h>
-#endif
-
-#ifdef UNIX
-#include <X11/Xlib.h>
-#include <X11/extensions/XTest.h>
-#endif
-
-#include <unordered_map>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
 #include "types.hpp"
 
 namespace FakeInput
 {
-
-    struct Mouse 
+    /** Represents mouse device.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    struct Mouse_base
     {
-        static DWORD translateMouseButton(MouseButton button) 
+        static constexpr auto translateMouseButton(MouseButton button)
         {
-#ifdef WIN32
-            static const std::unordered_map<MouseButton, DWORD> buttonMap = {
-                { MouseButton::Mouse_Left, MOUSEEVENTF_LEFTDOWN },
-                { MouseButton::Mouse_Right, MOUSEEVENTF_RIGHTDOWN },
-                { MouseButton::Mouse_Middle, MOUSEEVENTF_MIDDLEDOWN }
-            };
-
-            auto it = buttonMap.find(button);
-            return it != buttonMap.end() ? it->second : 0;
-#elif defined(UNIX)
-            // X11 buttons: 1 = left, 2 = middle, 3 = right
-            static const std::unordered_map<MouseButton, unsigned int> buttonMap = {
-                { MouseButton::Mouse_Left, 1 },
-                { MouseButton::Mouse_Middle, 2 },
-                { MouseButton::Mouse_Right, 3 }
-            };
-
-            auto it = buttonMap.find(button);
-            return it != buttonMap.end() ? it->second : 0;
-#endif
+            return FakeInput::translateMouseButton(button);
         }
 
         static void move(int dx, int dy) {
-#ifdef WIN32
-            INPUT input{};
-            input.type = INPUT_MOUSE;
-            input.mi.dwFlags = MOUSEEVENTF_MOVE;
-            input.mi.dx = dx;
-            input.mi.dy = dy;
-            ::SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            Display* display = XOpenDisplay(nullptr);
-            if (display) {
-                XTestFakeRelativeMotionEvent(display, dx, dy, CurrentTime);
-                XFlush(display);
-                XCloseDisplay(display);
-            }
-#endif
+            sendPointerEvent_(Event_Move, dx, dy);
         }
 
         static void pressButton(MouseButton button) {
-#ifdef WIN32
-            INPUT input{};
-            input.type = INPUT_MOUSE;
-            input.mi.dwFlags = translateMouseButton(button);  // e.g., MOUSEEVENTF_LEFTDOWN
-            ::SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            Display* display = XOpenDisplay(nullptr);
-            if (display) {
-                XTestFakeButtonEvent(display, static_cast<unsigned int>(button) + 1, True, CurrentTime);
-                XFlush(display);
-                XCloseDisplay(display);
-            }
-#endif
+            sendButtonEvent_(button, true);
         }
 
         static void releaseButton(MouseButton button) {
-#ifdef WIN32
-            INPUT input{};
-            input.type = INPUT_MOUSE;
-            input.mi.dwFlags = translateMouseButton(button) << 1;  // e.g., MOUSEEVENTF_LEFTUP
-            ::SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            Display* display = XOpenDisplay(nullptr);
-            if (display) {
-                XTestFakeButtonEvent(display, static_cast<unsigned int>(button) + 1, False, CurrentTime);
-                XFlush(display);
-                XCloseDisplay(display);
-            }
-#endif
+            sendButtonEvent_(button, false);
         }
 
         static void moveTo(int x, int y) {
-#ifdef WIN32
-            INPUT input{};
-            input.type = INPUT_MOUSE;
-            input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE;
-
-            // Normalize to 065535
-            input.mi.dx = static_cast<LONG>(x * (65535.0f / GetSystemMetrics(SM_CXSCREEN)));
-            input.mi.dy = static_cast<LONG>(y * (65535.0f / GetSystemMetrics(SM_CYSCREEN)));
-            ::SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            Display* display = XOpenDisplay(nullptr);
-            if (display) {
-                Window root = DefaultRootWindow(display);
-                XWarpPointer(display, None, root, 0, 0, 0, 0, x, y);
-                XFlush(display);
-                XCloseDisplay(display);
-            }
-#endif
+            sendPointerEvent_(Event_MoveTo, x, y);
         }
 
         static void wheelUp()
         {
-#ifdef WIN32
-            INPUT input{};
-            input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-            input.mi.mouseData = WHEEL_DELTA;
-
-            SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            XTestFakeButtonEvent(display(), 4, true, CurrentTime);
-            XSync(display(), false);
-            XTestFakeButtonEvent(display(), 4, false, CurrentTime);
-            XFlush(display());
-#endif
+            sendPointerEvent_(Event_Wheel, 0, 1);
         }
 
         static void wheelDown()
         {
-#ifdef WIN32
-            INPUT input{};
-            input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-            input.mi.mouseData = -WHEEL_DELTA;
-
-            SendInput(1, &input, sizeof(INPUT));
-#elif defined(UNIX)
-            XTestFakeButtonEvent(display(), 5, true, CurrentTime);
-            XSync(display(), false);
-            XTestFakeButtonEvent(display(), 5, false, CurrentTime);
-            XFlush(display());
-#endif
+            sendPointerEvent_(Event_Wheel, 0, -1);
+        }
+
+    private:
+        static void sendButtonEvent_(MouseButton button, bool isPress)
+        {
+            InputEvent event{};
+            event.type = isPress ? Event_ButtonPress : Event_ButtonRelease;
+            event.button = button;
+
+            Backend_t::submit(&event, 1);
+        }
+
+        static void sendPointerEvent_(EventType type, int x, int y)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.x = x;
+            event.y = y;
+
+            Backend_t::submit(&event, 1);
         }
     };
+
+    using Mouse = Mouse_base<SystemBackend>;
 }
 
 #endif
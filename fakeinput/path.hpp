@@ -0,0 +1,306 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_PATH_HPP
+#define FI_PATH_HPP
+
+#include "config.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "batch.hpp"
+#include "event.hpp"
+#include "screen.hpp"
+
+namespace FakeInput
+{
+    /** Speed profile of the motion along a path */
+    enum Easing {
+        Ease_None, // constant speed
+        Ease_In, // accelerates from zero speed
+        Ease_Out, // decelerates to zero speed
+        Ease_InOut // accelerates, then decelerates
+    };
+
+    /** Generates smooth pointer trajectories and sends them as one timed batch.
+     *
+     * Samples are computed for the whole path at once into separate x and
+     * y arrays, each step is a plain loop over the arrays without branches
+     * so the compiler can vectorize it. Coordinates are virtual desktop
+     * pixels, see ScreenGeometry. The path is sent as absolute moves
+     * spaced by the sample period, which the X server paces by itself on
+     * Unix (see InputBatch::wait()).
+     */
+    class MousePath
+    {
+    public:
+        /** Creates empty path.
+         *
+         * @param sampleRate
+         *      Number of points per second.
+         * @param easing
+         *      Speed profile of the following segments.
+         */
+        explicit MousePath(unsigned int sampleRate = 125, Easing easing = Ease_None)
+            : sampleRate_(sampleRate ? sampleRate : 1), easing_(easing)
+        {
+        }
+
+        void setEasing(Easing easing)
+        {
+            easing_ = easing;
+        }
+
+        /** Appends straight segment.
+         *
+         * @param duration
+         *      Time to travel the segment in miliseconds.
+         */
+        MousePath& linear(int fromX, int fromY, int toX, int toY, unsigned int duration)
+        {
+            std::size_t first = beginSegment_(duration);
+            std::size_t count = xs_.size() - first;
+            float* x = xs_.data() + first;
+            float* y = ys_.data() + first;
+
+            const float ax = static_cast<float>(fromX);
+            const float ay = static_cast<float>(fromY);
+            const float bx = static_cast<float>(toX - fromX);
+            const float by = static_cast<float>(toY - fromY);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                float t = t_[i];
+                x[i] = ax + bx * t;
+                y[i] = ay + by * t;
+            }
+
+            return *this;
+        }
+
+        /** Appends cubic Bezier segment.
+         *
+         * @param duration
+         *      Time to travel the segment in miliseconds.
+         */
+        MousePath& bezier(int fromX, int fromY, int control1X, int control1Y,
+            int control2X, int control2Y, int toX, int toY, unsigned int duration)
+        {
+            std::size_t first = beginSegment_(duration);
+            std::size_t count = xs_.size() - first;
+            float* x = xs_.data() + first;
+            float* y = ys_.data() + first;
+
+            const float x0 = static_cast<float>(fromX), y0 = static_cast<float>(fromY);
+            const float x1 = static_cast<float>(control1X), y1 = static_cast<float>(control1Y);
+            const float x2 = static_cast<float>(control2X), y2 = static_cast<float>(control2Y);
+            const float x3 = static_cast<float>(toX), y3 = static_cast<float>(toY);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                float t = t_[i];
+                float u = 1.0f - t;
+                float b0 = u * u * u;
+                float b1 = 3.0f * u * u * t;
+                float b2 = 3.0f * u * t * t;
+                float b3 = t * t * t;
+                x[i] = b0 * x0 + b1 * x1 + b2 * x2 + b3 * x3;
+                y[i] = b0 * y0 + b1 * y1 + b2 * y2 + b3 * y3;
+            }
+
+            return *this;
+        }
+
+        /** Number of points of the path */
+        std::size_t size() const
+        {
+            return xs_.size();
+        }
+
+        /** X coordinates of the points in pixels */
+        const std::vector<float>& xs() const
+        {
+            return xs_;
+        }
+
+        /** Y coordinates of the points in pixels */
+        const std::vector<float>& ys() const
+        {
+            return ys_;
+        }
+
+        /** Removes all points. */
+        void clear()
+        {
+            xs_.clear();
+            ys_.clear();
+            delays_.clear();
+        }
+
+        /** Appends the path to the batch as timed absolute moves. */
+        template<typename Backend_t>
+        void appendTo(InputBatch_base<Backend_t>& batch) const
+        {
+            std::size_t count = xs_.size();
+            toScreen_(count);
+
+            InputEvent event{};
+#ifdef WIN32
+            event.type = Event_MoveToNormalized;
+#else
+            event.type = Event_MoveTo;
+#endif
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                event.x = screenX_[i];
+                event.y = screenY_[i];
+                batch.wait(delays_[i]).add(event);
+            }
+        }
+
+        /** Sends the whole path with one submission.
+         *
+         * @returns number of events the system accepted.
+         */
+        std::size_t send() const
+        {
+            InputBatch batch(xs_.size());
+            appendTo(batch);
+            return batch.commit();
+        }
+
+    private:
+        /** Appends sample times of a new segment, fills t_ with eased progress.
+         *
+         * @returns index of the first point of the segment.
+         */
+        std::size_t beginSegment_(unsigned int duration)
+        {
+            std::size_t steps = static_cast<std::size_t>(duration) * sampleRate_ / 1000;
+            if (steps == 0)
+            {
+                steps = 1;
+            }
+
+            // the first point of the path is sent at once, the following
+            // ones a sample period apart, rounded to whole miliseconds
+            std::size_t first = xs_.size();
+            bool startsPath = first == 0;
+            std::size_t count = startsPath ? steps + 1 : steps;
+
+            xs_.resize(first + count);
+            ys_.resize(first + count);
+            t_.resize(count);
+
+            const float step = 1.0f / static_cast<float>(steps);
+            const float offset = startsPath ? 0.0f : 1.0f;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                t_[i] = (static_cast<float>(i) + offset) * step;
+            }
+            ease_(t_.data(), count);
+
+            const double period = 1000.0 / sampleRate_;
+            for (std::size_t point = first; point < first + count; ++point)
+            {
+                long long at = std::llround(point * period);
+                long long before = point == 0 ? 0 : std::llround((point - 1) * period);
+                delays_.push_back(static_cast<unsigned int>(at - before));
+            }
+
+            return first;
+        }
+
+        void ease_(float* t, std::size_t count) const
+        {
+            switch (easing_)
+            {
+            case Ease_None:
+                break;
+            case Ease_In:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    t[i] = t[i] * t[i] * t[i];
+                }
+                break;
+            case Ease_Out:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    float u = 1.0f - t[i];
+                    t[i] = 1.0f - u * u * u;
+                }
+                break;
+            case Ease_InOut:
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    float s = t[i];
+                    t[i] = s * s * (3.0f - 2.0f * s); // smoothstep
+                }
+                break;
+            }
+        }
+
+        /** Converts points to the coordinates taken by the absolute move events. */
+        void toScreen_(std::size_t count) const
+        {
+            screenX_.resize(count);
+            screenY_.resize(count);
+
+#ifdef WIN32
+            // normalize to 0-65535 over the virtual desktop
+            const ScreenRect desktop = ScreenGeometry::desktop();
+            const float offsetX = static_cast<float>(-desktop.left);
+            const float offsetY = static_cast<float>(-desktop.top);
+            const float scaleX = static_cast<float>(ScreenGeometry::NormalizedMax) / (desktop.width > 1 ? desktop.width - 1 : 1);
+            const float scaleY = static_cast<float>(ScreenGeometry::NormalizedMax) / (desktop.height > 1 ? desktop.height - 1 : 1);
+#else
+            const float offsetX = 0.0f;
+            const float offsetY = 0.0f;
+            const float scaleX = 1.0f;
+            const float scaleY = 1.0f;
+#endif
+            const float* x = xs_.data();
+            const float* y = ys_.data();
+            int* sx = screenX_.data();
+            int* sy = screenY_.data();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                sx[i] = static_cast<int>(std::floor((x[i] + offsetX) * scaleX + 0.5f));
+                sy[i] = static_cast<int>(std::floor((y[i] + offsetY) * scaleY + 0.5f));
+            }
+        }
+
+        unsigned int sampleRate_;
+        Easing easing_;
+
+        std::vector<float> xs_;
+        std::vector<float> ys_;
+        std::vector<unsigned int> delays_;
+        std::vector<float> t_; // progress of the segment being generated
+
+        mutable std::vector<int> screenX_;
+        mutable std::vector<int> screenY_;
+    };
+}
+
+#endif
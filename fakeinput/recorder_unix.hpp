@@ -0,0 +1,375 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_RECORDER_UNIX_HPP
+#define FI_RECORDER_UNIX_HPP
+
+#include "config.hpp"
+#ifdef UNIX
+
+#include <X11/Xlib.h>
+#include <X11/Xproto.h>
+#include <X11/extensions/record.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "display_unix.hpp"
+#include "event.hpp"
+#include "key_unix.hpp"
+#include "macro.hpp"
+#include "ring.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Device event as captured from the X server */
+    struct RecordedEvent
+    {
+        std::uint32_t time; // server time in miliseconds
+        std::int16_t x; // root position of motion events
+        std::int16_t y;
+        std::uint8_t type; // KeyPress to MotionNotify
+        std::uint8_t detail; // keycode or button
+    };
+
+    /** Records keyboard and mouse input of all clients into a macro file.
+     *
+     * Uses the XRecord extension. The capture thread only copies device
+     * events into a lock-free ring, a writer thread drains the ring,
+     * converts the events and streams them to the file with MacroWriter,
+     * so the X server is never held up by file output. Delays between
+     * events come from the server timestamps. Events which do not fit
+     * the ring are counted, see overflowCount().
+     *
+     * XRecord needs a connection of its own for the data it sends, the
+     * context is created and disabled through display().
+     *
+     * @warning @image html tux.png
+     *    Unix-like platform only
+     */
+    class Recorder
+    {
+    public:
+        /** Creates recorder.
+         *
+         * @param capacity
+         *      Number of events the ring can hold while the writer catches up.
+         */
+        explicit Recorder(std::size_t capacity = 65536)
+            : ring_(capacity)
+        {
+        }
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        /** Stops recording. */
+        ~Recorder()
+        {
+            stop();
+        }
+
+        /** Starts recording into the file, replacing its content.
+         *
+         * @returns false if the file cannot be created or XRecord is unavailable.
+         */
+        bool start(const std::string& path)
+        {
+            if (isRecording_)
+            {
+                return false;
+            }
+
+            Display* control = display();
+            int major = 0;
+            int minor = 0;
+            if (!control || !XRecordQueryVersion(control, &major, &minor))
+            {
+                std::cerr << "XRecord extension is not available" << std::endl;
+                return false;
+            }
+
+            file_ = std::fopen(path.c_str(), "wb");
+            if (!file_)
+            {
+                std::cerr << "Cannot open macro file " << path << std::endl;
+                return false;
+            }
+
+            data_ = XOpenDisplay(DisplayString(control));
+            XRecordRange* range = XRecordAllocRange();
+            if (!data_ || !range)
+            {
+                if (range)
+                {
+                    XFree(range);
+                }
+                return abort_();
+            }
+
+            range->device_events.first = KeyPress;
+            range->device_events.last = MotionNotify;
+            XRecordClientSpec clients = XRecordAllClients;
+            context_ = XRecordCreateContext(control, 0, &clients, 1, &range, 1);
+            XFree(range);
+            XSync(control, False); // the data connection must see the context
+
+            if (!context_)
+            {
+                return abort_();
+            }
+
+            overflow_.store(0, std::memory_order_relaxed);
+            capturing_.store(true, std::memory_order_release);
+            isRecording_ = true;
+
+            captureThread_ = std::thread(&Recorder::capture_, this);
+            writerThread_ = std::thread(&Recorder::write_, this);
+            return true;
+        }
+
+        /** Stops recording, writes the rest of the events and closes the file.
+         *
+         * Reports on stderr how many events did not fit the ring.
+         */
+        void stop()
+        {
+            if (!isRecording_)
+            {
+                return;
+            }
+
+            Display* control = display();
+            if (control)
+            {
+                XRecordDisableContext(control, context_);
+                XSync(control, False);
+            }
+            captureThread_.join();
+
+            capturing_.store(false, std::memory_order_release);
+            writerThread_.join();
+
+            if (control)
+            {
+                XRecordFreeContext(control, context_);
+                XFlush(control);
+            }
+            context_ = 0;
+
+            XCloseDisplay(data_);
+            data_ = nullptr;
+
+            std::fclose(file_);
+            file_ = nullptr;
+            isRecording_ = false;
+
+            std::uint64_t overflow = overflowCount();
+            if (overflow > 0)
+            {
+                std::cerr << "Recorder dropped " << overflow << " events, the ring was full" << std::endl;
+            }
+        }
+
+        bool isRecording() const
+        {
+            return isRecording_;
+        }
+
+        /** Number of events of the current or last recording which did not fit the ring. */
+        std::uint64_t overflowCount() const
+        {
+            return overflow_.load(std::memory_order_relaxed);
+        }
+
+        std::size_t capacity() const
+        {
+            return ring_.capacity();
+        }
+
+    private:
+        bool abort_()
+        {
+            if (data_)
+            {
+                XCloseDisplay(data_);
+                data_ = nullptr;
+            }
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+
+        /** Blocks in XRecordEnableContext until stop() disables the context. */
+        void capture_()
+        {
+            XRecordEnableContext(data_, context_, &Recorder::intercept_, reinterpret_cast<XPointer>(this));
+        }
+
+        static void intercept_(XPointer closure, XRecordInterceptData* data)
+        {
+            Recorder* recorder = reinterpret_cast<Recorder*>(closure);
+
+            if (data->category == XRecordFromServer && data->data_len * 4 >= sizeof(xEvent))
+            {
+                const xEvent* event = reinterpret_cast<const xEvent*>(data->data);
+
+                RecordedEvent recorded{};
+                recorded.type = event->u.u.type & 0x7F; // strip the SendEvent bit
+                recorded.detail = event->u.u.detail;
+                recorded.time = static_cast<std::uint32_t>(event->u.keyButtonPointer.time);
+                recorded.x = event->u.keyButtonPointer.rootX;
+                recorded.y = event->u.keyButtonPointer.rootY;
+
+                if (!recorder->ring_.tryPush(recorded))
+                {
+                    recorder->overflow_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            XRecordFreeData(data);
+        }
+
+        /** Drains the ring into the file until capturing stops and the ring is empty. */
+        void write_()
+        {
+            MacroWriter writer;
+            std::uint32_t lastTime = 0;
+            bool hasTime = false;
+
+            for (;;)
+            {
+                bool capturing = capturing_.load(std::memory_order_acquire);
+
+                RecordedEvent recorded;
+                std::size_t drained = 0;
+                while (ring_.tryPop(recorded))
+                {
+                    InputEvent event{};
+                    if (!toInputEvent_(recorded, event))
+                    {
+                        continue;
+                    }
+
+                    // server time wraps after 49 days, unsigned difference still holds
+                    event.delay = hasTime ? recorded.time - lastTime : 0;
+                    lastTime = recorded.time;
+                    hasTime = true;
+
+                    writer.add(event);
+                    ++drained;
+                }
+
+                if (drained > 0)
+                {
+                    writer.writeTo(file_);
+                }
+                else if (!capturing && ring_.empty())
+                {
+                    break;
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+
+            writer.finish();
+            writer.writeTo(file_);
+        }
+
+        /** Converts captured event, returns false for events a macro does not need. */
+        static bool toInputEvent_(const RecordedEvent& recorded, InputEvent& event)
+        {
+            switch (recorded.type)
+            {
+            case KeyPress:
+            case KeyRelease:
+            {
+                XEvent keyEvent{};
+                keyEvent.xkey.type = recorded.type;
+                keyEvent.xkey.display = display();
+                keyEvent.xkey.keycode = recorded.detail;
+
+                event.type = recorded.type == KeyPress ? Event_KeyPress : Event_KeyRelease;
+                event.key = CreateKeyFromEvent(&keyEvent);
+                return true;
+            }
+            case ButtonPress:
+            case ButtonRelease:
+                if (recorded.detail >= 4 && recorded.detail <= 5)
+                {
+                    if (recorded.type == ButtonRelease)
+                    {
+                        return false; // wheel steps are whole clicks
+                    }
+
+                    event.type = Event_Wheel;
+                    event.y = recorded.detail == 4 ? 1 : -1;
+                    return true;
+                }
+
+                for (int button = 0; button < MouseButtonCount; ++button)
+                {
+                    if (translateMouseButton(static_cast<MouseButton>(button)) == recorded.detail)
+                    {
+                        event.type = recorded.type == ButtonPress ? Event_ButtonPress : Event_ButtonRelease;
+                        event.button = static_cast<MouseButton>(button);
+                        return true;
+                    }
+                }
+                return false;
+            case MotionNotify:
+                event.type = Event_MoveTo;
+                event.x = recorded.x;
+                event.y = recorded.y;
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        MpscRing<RecordedEvent> ring_;
+        std::atomic<std::uint64_t> overflow_{ 0 };
+        std::atomic<bool> capturing_{ false };
+        bool isRecording_ = false;
+
+        Display* data_ = nullptr;
+        XRecordContext context_ = 0;
+        std::FILE* file_ = nullptr;
+
+        std::thread captureThread_;
+        std::thread writerThread_;
+    };
+}
+
+#endif
+#endif
@@ -0,0 +1,165 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_RING_HPP
+#define FI_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace FakeInput
+{
+    /** Bounded lock-free queue for many producers and one consumer.
+     *
+     * Each slot carries a sequence number telling whether it is free or
+     * filled for the current lap, so producers only contend on the tail
+     * index and never block each other or the consumer. Pops are done with
+     * a compare-and-swap as well, which lets a producer discard the oldest
+     * entry when the queue is full.
+     *
+     * @tparam T
+     *      Trivially copyable element type.
+     */
+    template<typename T>
+    class MpscRing
+    {
+    public:
+        /** Creates ring for at least the given number of elements.
+         *
+         * @param capacity
+         *      Requested capacity, rounded up to a power of two.
+         */
+        explicit MpscRing(std::size_t capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            mask_ = size - 1;
+            cells_.reset(new Cell_[size]);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpscRing(const MpscRing&) = delete;
+        MpscRing& operator=(const MpscRing&) = delete;
+
+        /** Appends element, fails if the ring is full. */
+        bool tryPush(const T& value)
+        {
+            std::size_t position = tail_.load(std::memory_order_relaxed);
+            Cell_* cell;
+            for (;;)
+            {
+                cell = &cells_[position & mask_];
+                std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+                if (diff == 0)
+                {
+                    if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // slot of the previous lap not consumed yet
+                }
+                else
+                {
+                    position = tail_.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = value;
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** Removes the oldest element, fails if the ring is empty. */
+        bool tryPop(T& value)
+        {
+            std::size_t position = head_.load(std::memory_order_relaxed);
+            Cell_* cell;
+            for (;;)
+            {
+                cell = &cells_[position & mask_];
+                std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+
+                if (diff == 0)
+                {
+                    if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // not published yet
+                }
+                else
+                {
+                    position = head_.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = cell->value;
+            cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** Whether the ring looks empty, exact only when no producer is active. */
+        bool empty() const
+        {
+            return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+        }
+
+        std::size_t capacity() const
+        {
+            return mask_ + 1;
+        }
+
+    private:
+        struct Cell_
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        alignas(64) std::atomic<std::size_t> tail_{ 0 };
+        alignas(64) std::atomic<std::size_t> head_{ 0 };
+        alignas(64) std::size_t mask_;
+        std::unique_ptr<Cell_[]> cells_;
+    };
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_SCHEDULER_HPP
+#define FI_SCHEDULER_HPP
+
+#include "config.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
+#include "system.hpp"
+
+namespace FakeInput
+{
+    /** Event to inject at an absolute time */
+    struct TimedEvent
+    {
+        std::int64_t deadline; // monotonicTime() in nanoseconds
+        InputEvent event;
+    };
+
+    /** Injects events at absolute deadlines with sub-millisecond precision.
+     *
+     * Events are executed in deadline order. Events which are due at the
+     * same time are submitted together with one system call. For every
+     * event the scheduler records how late it was submitted.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class Scheduler_base
+    {
+    public:
+        /** Creates scheduler.
+         *
+         * @param spinThreshold
+         *      Nanoseconds before a deadline at which sleeping switches to busy-waiting.
+         */
+        explicit Scheduler_base(std::int64_t spinThreshold = DefaultSpinThreshold)
+            : spinThreshold_(spinThreshold)
+        {
+        }
+
+        /** Schedules event at the absolute deadline. */
+        void schedule(std::int64_t deadline, const InputEvent& event)
+        {
+            TimedEvent timed{ deadline, event };
+            events_.push_back(timed);
+            latestDeadline_ = events_.size() == 1 ? deadline : std::max(latestDeadline_, deadline);
+        }
+
+        /** Schedules event the given time after the latest scheduled deadline.
+         *
+         * The first event is scheduled relative to now.
+         */
+        void scheduleAfter(std::int64_t delay, const InputEvent& event)
+        {
+            std::int64_t base = monotonicTime();
+            if (!events_.empty())
+            {
+                base = std::max(base, latestDeadline_);
+            }
+
+            schedule(base + delay, event);
+        }
+
+        std::size_t size() const
+        {
+            return events_.size();
+        }
+
+        void setSpinThreshold(std::int64_t spinThreshold)
+        {
+            spinThreshold_ = spinThreshold;
+        }
+
+        /** Injects all scheduled events, blocking until the last one is sent.
+         *
+         * Lateness of the previous run is replaced.
+         *
+         * @returns number of events the system accepted.
+         */
+        std::size_t run()
+        {
+            std::stable_sort(events_.begin(), events_.end(), [](const TimedEvent& a, const TimedEvent& b) {
+                return a.deadline < b.deadline;
+            });
+
+            lateness_.clear();
+            lateness_.reserve(events_.size());
+            burst_.reserve(events_.size());
+
+            std::size_t sent = 0;
+            std::size_t next = 0;
+            while (next < events_.size())
+            {
+                sleepUntil(events_[next].deadline, spinThreshold_);
+
+                // everything due by now goes out together
+                std::int64_t now = monotonicTime();
+                burst_.clear();
+                while (next < events_.size() && events_[next].deadline <= now)
+                {
+                    burst_.push_back(events_[next].event);
+                    lateness_.push_back(now - events_[next].deadline);
+                    ++next;
+                }
+
+                sent += Backend_t::submit(burst_.data(), burst_.size());
+            }
+
+            events_.clear();
+            return sent;
+        }
+
+        /** Nanoseconds each event of the last run was submitted after its deadline, in deadline order. */
+        const std::vector<std::int64_t>& lateness() const
+        {
+            return lateness_;
+        }
+
+        /** Largest lateness of the last run in nanoseconds */
+        std::int64_t maxLateness() const
+        {
+            return lateness_.empty() ? 0 : *std::max_element(lateness_.begin(), lateness_.end());
+        }
+
+    private:
+        std::int64_t spinThreshold_;
+        std::vector<TimedEvent> events_;
+        std::int64_t latestDeadline_ = 0; // of events_, valid while it is not empty
+        std::vector<InputEvent> burst_;
+        std::vector<std::int64_t> lateness_;
+    };
+
+    using Scheduler = Scheduler_base<SystemBackend>;
+}
+
+#endif
@@ -0,0 +1,349 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_SCREEN_HPP
+#define FI_SCREEN_HPP
+
+#include "config.hpp"
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+#ifdef UNIX
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+#include "display_unix.hpp"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace FakeInput
+{
+    /** Geometry of the virtual desktop spanning all monitors */
+    struct ScreenRect
+    {
+        int left;
+        int top;
+        int width;
+        int height;
+    };
+
+    /** Cached geometry of the virtual desktop.
+     *
+     * Absolute coordinates are pixels of the virtual desktop, which covers
+     * all monitors (on Windows the primary monitor starts at 0,0, others
+     * may lie at negative coordinates). The geometry is queried once and
+     * scale factors to the 0-65535 normalized space are precomputed in
+     * 16.16 fixed point, so normalizing is a subtraction and a
+     * multiply-shift. Call refreshScreenGeometry() for display change
+     * notifications or ScreenGeometry::invalidate() when monitors change.
+     */
+    class ScreenGeometry
+    {
+    public:
+        /** Largest normalized coordinate */
+        static constexpr int NormalizedMax = 65535;
+
+        static ScreenRect desktop()
+        {
+            return data_().rect;
+        }
+
+        /** Converts virtual desktop x coordinate to the normalized space. */
+        static int normalizeX(int x)
+        {
+            Data_ data = data_();
+            return normalize_(x - data.rect.left, data.scaleX);
+        }
+
+        /** Converts virtual desktop y coordinate to the normalized space. */
+        static int normalizeY(int y)
+        {
+            Data_ data = data_();
+            return normalize_(y - data.rect.top, data.scaleY);
+        }
+
+        /** Converts normalized x coordinate to the virtual desktop. */
+        static int denormalizeX(int x)
+        {
+            Data_ data = data_();
+            return data.rect.left + denormalize_(x, data.rect.width);
+        }
+
+        /** Converts normalized y coordinate to the virtual desktop. */
+        static int denormalizeY(int y)
+        {
+            Data_ data = data_();
+            return data.rect.top + denormalize_(y, data.rect.height);
+        }
+
+        /** Marks the geometry stale, it is queried again on next use. */
+        static void invalidate()
+        {
+            shared_().generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+#ifdef UNIX
+        /** Asks the X server to report screen changes to the connection.
+         *
+         * Events then have to be read from this connection and passed to
+         * refreshScreenGeometry().
+         *
+         * @returns false if the server lacks the RandR extension.
+         */
+        static bool selectChangeEvents(Display* dpy)
+        {
+            int eventBase = 0;
+            int errorBase = 0;
+            if (!XRRQueryExtension(dpy, &eventBase, &errorBase))
+            {
+                return false;
+            }
+
+            randrEventBase_().store(eventBase, std::memory_order_relaxed);
+            XRRSelectInput(dpy, DefaultRootWindow(dpy), RRScreenChangeNotifyMask);
+            XFlush(dpy);
+            return true;
+        }
+#endif
+
+    private:
+        struct Data_
+        {
+            ScreenRect rect;
+            std::int64_t scaleX; // normalized units per pixel, 16.16 fixed point
+            std::int64_t scaleY;
+        };
+
+        static int normalize_(int offset, std::int64_t scale)
+        {
+            std::int64_t normalized = (static_cast<std::int64_t>(offset) * scale) >> 16;
+            if (normalized < 0)
+            {
+                return 0;
+            }
+            return normalized > NormalizedMax ? NormalizedMax : static_cast<int>(normalized);
+        }
+
+        static int denormalize_(int normalized, int size)
+        {
+            return static_cast<int>((static_cast<std::int64_t>(normalized) * (size - 1) + NormalizedMax / 2) / NormalizedMax);
+        }
+
+        static std::int64_t scale_(int size)
+        {
+            // maps the last pixel to NormalizedMax, rounded up so it is reached
+            std::int64_t span = size > 1 ? size - 1 : 1;
+            return ((static_cast<std::int64_t>(NormalizedMax) << 16) + span - 1) / span;
+        }
+
+        /** Published geometry.
+         *
+         * Fields are atomics guarded by a sequence lock: a reader retries
+         * while a query rewrites them, so it always gets one consistent
+         * geometry and no buffer is reused under it, like in KeyCache.
+         */
+        struct Shared_
+        {
+            std::atomic<unsigned> sequence{ 0 }; // odd while being written
+            std::atomic<int> left{ 0 };
+            std::atomic<int> top{ 0 };
+            std::atomic<int> width{ 0 };
+            std::atomic<int> height{ 0 };
+            std::atomic<std::int64_t> scaleX{ 0 };
+            std::atomic<std::int64_t> scaleY{ 0 };
+            std::atomic<std::uint64_t> generation{ 1 }; // bumped by invalidate()
+            std::atomic<std::uint64_t> builtGeneration{ 0 }; // generation of the fields
+        };
+
+        static Shared_& shared_()
+        {
+            static Shared_ shared;
+            return shared;
+        }
+
+        static Data_ data_()
+        {
+            const Shared_& shared = shared_();
+            if (shared.builtGeneration.load(std::memory_order_acquire) == shared.generation.load(std::memory_order_acquire))
+            {
+                return read_();
+            }
+
+            return query_();
+        }
+
+        static Data_ read_()
+        {
+            const Shared_& shared = shared_();
+            for (;;)
+            {
+                unsigned sequence = shared.sequence.load(std::memory_order_acquire);
+                if (sequence & 1)
+                {
+                    continue; // a query is writing
+                }
+
+                Data_ data;
+                data.rect.left = shared.left.load(std::memory_order_relaxed);
+                data.rect.top = shared.top.load(std::memory_order_relaxed);
+                data.rect.width = shared.width.load(std::memory_order_relaxed);
+                data.rect.height = shared.height.load(std::memory_order_relaxed);
+                data.scaleX = shared.scaleX.load(std::memory_order_relaxed);
+                data.scaleY = shared.scaleY.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (shared.sequence.load(std::memory_order_relaxed) == sequence)
+                {
+                    return data;
+                }
+            }
+        }
+
+        /** Queries the geometry, publishes it unless the desktop is unavailable. */
+        static Data_ query_()
+        {
+            static std::mutex mutex;
+            std::lock_guard<std::mutex> lock(mutex);
+
+            Shared_& shared = shared_();
+            std::uint64_t generation = shared.generation.load(std::memory_order_acquire);
+            if (shared.builtGeneration.load(std::memory_order_relaxed) == generation)
+            {
+                return read_(); // queried by another thread meanwhile
+            }
+
+            Data_ data;
+            data.rect = queryDesktop_();
+            data.scaleX = scale_(data.rect.width);
+            data.scaleY = scale_(data.rect.height);
+
+            if (data.rect.width <= 0 || data.rect.height <= 0)
+            {
+                return data; // no display now, ask again next time
+            }
+
+            unsigned sequence = shared.sequence.load(std::memory_order_relaxed);
+            shared.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            shared.left.store(data.rect.left, std::memory_order_relaxed);
+            shared.top.store(data.rect.top, std::memory_order_relaxed);
+            shared.width.store(data.rect.width, std::memory_order_relaxed);
+            shared.height.store(data.rect.height, std::memory_order_relaxed);
+            shared.scaleX.store(data.scaleX, std::memory_order_relaxed);
+            shared.scaleY.store(data.scaleY, std::memory_order_relaxed);
+
+            shared.sequence.store(sequence + 2, std::memory_order_release);
+
+            // an invalidate() during the query leaves the generations apart
+            shared.builtGeneration.store(generation, std::memory_order_release);
+            return data;
+        }
+
+#ifdef WIN32
+        static ScreenRect queryDesktop_()
+        {
+            ScreenRect rect{};
+            rect.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+            rect.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+            rect.width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+            rect.height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+            return rect;
+        }
+#endif
+
+#ifdef UNIX
+        // the root window spans all monitors of the screen
+        static ScreenRect queryDesktop_()
+        {
+            ScreenRect rect{};
+            Display* dpy = display();
+            if (dpy)
+            {
+                int screen = DefaultScreen(dpy);
+                rect.width = DisplayWidth(dpy, screen);
+                rect.height = DisplayHeight(dpy, screen);
+            }
+            return rect;
+        }
+
+        static std::atomic<int>& randrEventBase_()
+        {
+            static std::atomic<int> eventBase{ -1 };
+            return eventBase;
+        }
+
+        friend inline bool refreshScreenGeometry(XEvent* event);
+#endif
+    };
+
+#ifdef WIN32
+    /** Invalidates ScreenGeometry if the message announces display change.
+     *
+     * @returns whether the geometry was invalidated.
+     */
+    inline bool refreshScreenGeometry(const MSG* message)
+    {
+        if (message->message != WM_DISPLAYCHANGE) {
+            return false;
+        }
+
+        ScreenGeometry::invalidate();
+        return true;
+    }
+#endif
+
+#ifdef UNIX
+    /** Invalidates ScreenGeometry on RandR screen change notification.
+     *
+     * The connection must have been passed to ScreenGeometry::selectChangeEvents().
+     *
+     * @returns whether the geometry was invalidated.
+     */
+    inline bool refreshScreenGeometry(XEvent* event)
+    {
+        int eventBase = ScreenGeometry::randrEventBase_().load(std::memory_order_relaxed);
+        if (eventBase < 0 || event->type != eventBase + RRScreenChangeNotify)
+        {
+            return false;
+        }
+
+        XRRUpdateConfiguration(event);
+        ScreenGeometry::invalidate();
+        return true;
+    }
+#endif
+}
+
+#endif
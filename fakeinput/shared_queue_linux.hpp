@@ -0,0 +1,522 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_SHARED_QUEUE_LINUX_HPP
+#define FI_SHARED_QUEUE_LINUX_HPP
+
+#include "config.hpp"
+#if defined(UNIX) && defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "backend.hpp"
+#include "event.hpp"
+
+namespace FakeInput
+{
+    /** Event queue in shared memory, fed by other processes.
+     *
+     * One process creates the queue under a POSIX shared memory name,
+     * producer processes open it by the name and post events straight
+     * into its slots. The slots work like MpscRing: producers reserve a
+     * slot by advancing the tail and publish it with its sequence number,
+     * so the consumer sees the events in the order their slots were
+     * reserved. A sleeping consumer is woken through a futex in the
+     * shared memory, producers make the system call only when it sleeps.
+     *
+     * All processes must use the same build of the library, events are
+     * shared in their in-memory layout. A producer dying between
+     * reserving and publishing a slot stalls the queue.
+     *
+     * @warning @image html tux.png
+     *    Linux only
+     */
+    class SharedInputQueue
+    {
+    public:
+        SharedInputQueue() = default;
+
+        ~SharedInputQueue()
+        {
+            close();
+        }
+
+        SharedInputQueue(const SharedInputQueue&) = delete;
+        SharedInputQueue& operator=(const SharedInputQueue&) = delete;
+
+        /** Creates the queue, replacing any queue of the same name.
+         *
+         * The queue name is removed again when this object closes it.
+         *
+         * @param name
+         *      Shared memory name, e.g. "/fakeinput".
+         * @param capacity
+         *      Requested number of events, rounded up to a power of two.
+         *
+         * @returns false if the shared memory cannot be created.
+         */
+        bool create(const std::string& name, std::size_t capacity = 4096)
+        {
+            close();
+
+            std::size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            shm_unlink(name.c_str());
+            int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+            if (fd < 0)
+            {
+                return fail_("create", name);
+            }
+
+            std::size_t bytes = sizeof(Header_) + size * sizeof(Cell_);
+            if (ftruncate(fd, static_cast<off_t>(bytes)) != 0 || !map_(fd, bytes))
+            {
+                ::close(fd);
+                shm_unlink(name.c_str());
+                return fail_("create", name);
+            }
+            ::close(fd);
+
+            // fresh memory is zeroed, only the sequences need a start value
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            header_->mask = size - 1;
+            mask_ = size - 1;
+            header_->version = Version_;
+            header_->magic.store(Magic_, std::memory_order_release); // ready for producers
+
+            name_ = name;
+            return true;
+        }
+
+        /** Opens a queue created by another process.
+         *
+         * @returns false if there is no such queue.
+         */
+        bool open(const std::string& name)
+        {
+            close();
+
+            int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                return fail_("open", name);
+            }
+
+            struct stat info{};
+            bool isMapped = fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) > sizeof(Header_)
+                && map_(fd, static_cast<std::size_t>(info.st_size));
+            ::close(fd);
+
+            if (!isMapped || header_->magic.load(std::memory_order_acquire) != Magic_ || header_->version != Version_)
+            {
+                close();
+                return fail_("open", name);
+            }
+
+            // read once, the other process could change it under us
+            std::uint64_t size = header_->mask + 1;
+            if (size < 2 || (size & (size - 1)) != 0 || size > (bytes_ - sizeof(Header_)) / sizeof(Cell_))
+            {
+                close();
+                errno = EINVAL;
+                return fail_("open", name);
+            }
+
+            mask_ = size - 1;
+            return true;
+        }
+
+        /** Unmaps the queue, the creator also removes its name. */
+        void close()
+        {
+            if (header_)
+            {
+                munmap(header_, bytes_);
+                header_ = nullptr;
+                cells_ = nullptr;
+                bytes_ = 0;
+                mask_ = 0;
+            }
+            if (!name_.empty())
+            {
+                shm_unlink(name_.c_str());
+                name_.clear();
+            }
+        }
+
+        bool isOpen() const
+        {
+            return header_ != nullptr;
+        }
+
+        std::size_t capacity() const
+        {
+            return header_ ? mask_ + 1 : 0;
+        }
+
+        /** Appends event, fails if the queue is full. */
+        bool post(const InputEvent& event)
+        {
+            std::uint64_t position = header_->tail.load(std::memory_order_relaxed);
+            Cell_* cell;
+            for (;;)
+            {
+                cell = &cells_[position & mask_];
+                std::uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+                std::int64_t diff = static_cast<std::int64_t>(sequence - position);
+
+                if (diff == 0)
+                {
+                    if (header_->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // slot of the previous lap not consumed yet
+                }
+                else
+                {
+                    position = header_->tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->event = event;
+            cell->sequence.store(position + 1, std::memory_order_release);
+
+            wake_();
+            return true;
+        }
+
+        /** Appends events in order, stops at the first which does not fit.
+         *
+         * Events of other producers may come in between.
+         *
+         * @returns number of events posted.
+         */
+        std::size_t post(const InputEvent* events, std::size_t count)
+        {
+            std::size_t posted = 0;
+            while (posted < count && post(events[posted]))
+            {
+                ++posted;
+            }
+            return posted;
+        }
+
+        /** Removes up to max oldest events, consumer only.
+         *
+         * @returns number of events removed.
+         */
+        std::size_t drain(InputEvent* events, std::size_t max)
+        {
+            std::uint64_t position = header_->head.load(std::memory_order_relaxed);
+            std::size_t drained = 0;
+
+            while (drained < max)
+            {
+                Cell_& cell = cells_[position & mask_];
+                if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+                {
+                    break; // empty or not published yet
+                }
+
+                events[drained++] = cell.event;
+                cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+                ++position;
+            }
+
+            header_->head.store(position, std::memory_order_relaxed);
+            return drained;
+        }
+
+        /** Blocks the consumer until an event is posted, wake() is called or the timeout elapses.
+         *
+         * @param timeout
+         *      Nanoseconds to wait at most.
+         */
+        void wait(std::int64_t timeout)
+        {
+            std::uint32_t wakeups = header_->wakeups.load(std::memory_order_acquire);
+
+            header_->sleeping.store(1, std::memory_order_relaxed);
+            // pairs with the fence in wake_(), either the producer sees us
+            // sleeping or we see its event
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (isEmpty_())
+            {
+                timespec relative{};
+                relative.tv_sec = static_cast<time_t>(timeout / 1000000000);
+                relative.tv_nsec = static_cast<long>(timeout % 1000000000);
+                syscall(SYS_futex, futexWord_(), FUTEX_WAIT, wakeups, &relative, nullptr, 0);
+            }
+
+            header_->sleeping.store(0, std::memory_order_relaxed);
+        }
+
+        /** Wakes the consumer from wait(). */
+        void wake()
+        {
+            header_->wakeups.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, futexWord_(), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        }
+
+    private:
+        static constexpr std::uint32_t Magic_ = 0x46495351; // "FISQ"
+        static constexpr std::uint32_t Version_ = 1;
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+            "atomics shared between processes must be lock-free");
+        static_assert(std::is_trivially_copyable<InputEvent>::value,
+            "events are copied between processes as raw memory");
+
+        struct Header_
+        {
+            std::atomic<std::uint32_t> magic;
+            std::uint32_t version;
+            std::uint64_t mask;
+            alignas(64) std::atomic<std::uint64_t> tail;
+            alignas(64) std::atomic<std::uint64_t> head;
+            alignas(64) std::atomic<std::uint32_t> wakeups; // futex word
+            std::atomic<std::uint32_t> sleeping;
+        };
+
+        struct Cell_
+        {
+            std::atomic<std::uint64_t> sequence;
+            InputEvent event;
+        };
+
+        bool map_(int fd, std::size_t bytes)
+        {
+            void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (memory == MAP_FAILED)
+            {
+                return false;
+            }
+
+            header_ = static_cast<Header_*>(memory);
+            cells_ = reinterpret_cast<Cell_*>(static_cast<char*>(memory) + sizeof(Header_));
+            bytes_ = bytes;
+            return true;
+        }
+
+        static bool fail_(const char* action, const std::string& name)
+        {
+            std::cerr << "Cannot " << action << " shared input queue " << name << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        bool isEmpty_() const
+        {
+            std::uint64_t head = header_->head.load(std::memory_order_relaxed);
+            return cells_[head & mask_].sequence.load(std::memory_order_acquire) != head + 1;
+        }
+
+        void wake_()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (header_->sleeping.load(std::memory_order_relaxed))
+            {
+                wake();
+            }
+        }
+
+        std::uint32_t* futexWord_()
+        {
+            return reinterpret_cast<std::uint32_t*>(&header_->wakeups);
+        }
+
+        Header_* header_ = nullptr;
+        Cell_* cells_ = nullptr;
+        std::size_t bytes_ = 0;
+        std::uint64_t mask_ = 0; // validated copy, the shared one is never read after open()
+        std::string name_; // set when this object created the queue
+    };
+
+    /** Injects events other processes post into a SharedInputQueue.
+     *
+     * Owns the queue and a thread which drains it and submits each
+     * drained run with one call of the backend, in queue order, so all
+     * producers end up in one well-paced stream.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class SharedInjector_base
+    {
+    public:
+        /** Creates the queue and starts the injector thread.
+         *
+         * @param name
+         *      Shared memory name producers open the queue by.
+         * @param capacity
+         *      Number of events the queue can hold.
+         */
+        explicit SharedInjector_base(const std::string& name, std::size_t capacity = 4096)
+        {
+            if (queue_.create(name, capacity))
+            {
+                thread_ = std::thread(&SharedInjector_base::run_, this);
+            }
+        }
+
+        SharedInjector_base(const SharedInjector_base&) = delete;
+        SharedInjector_base& operator=(const SharedInjector_base&) = delete;
+
+        /** Submits what is queued and removes the queue. */
+        ~SharedInjector_base()
+        {
+            stop();
+        }
+
+        bool isRunning() const
+        {
+            return thread_.joinable();
+        }
+
+        /** Submits what is queued and stops the injector thread. */
+        void stop()
+        {
+            if (!thread_.joinable())
+            {
+                return;
+            }
+
+            stopping_.store(true, std::memory_order_release);
+            queue_.wake();
+            thread_.join();
+        }
+
+        /** Number of events submitted so far. */
+        std::uint64_t submittedCount() const
+        {
+            return submitted_.load(std::memory_order_relaxed);
+        }
+
+        /** Number of events dropped for an unknown type or button. */
+        std::uint64_t droppedCount() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /** Upper bound of events submitted with one call */
+        static constexpr std::size_t MaxBurst_ = 512;
+
+        /** Longest sleep between checks of stop(), in nanoseconds */
+        static constexpr std::int64_t WaitTimeout_ = 100000000;
+
+        /** Checks event written by another process, as decodeWireEvent() does for the daemon.
+         *
+         * The enums are read through their bytes, the producer may have
+         * stored any value there. Negative values wrap above the limits.
+         */
+        static bool isValid_(const InputEvent& event)
+        {
+            std::underlying_type_t<EventType> type;
+            std::underlying_type_t<MouseButton> button;
+            std::memcpy(&type, &event.type, sizeof(type));
+            std::memcpy(&button, &event.button, sizeof(button));
+
+            return static_cast<std::uint64_t>(type) <= static_cast<std::uint64_t>(Event_UnicodeRelease)
+                && static_cast<std::uint64_t>(button) < static_cast<std::uint64_t>(MouseButtonCount);
+        }
+
+        void run_()
+        {
+            std::vector<InputEvent> burst(MaxBurst_);
+
+            for (;;)
+            {
+                bool stopping = stopping_.load(std::memory_order_acquire);
+
+                std::size_t drained = queue_.drain(burst.data(), burst.size());
+                if (drained > 0)
+                {
+                    std::size_t valid = 0;
+                    for (std::size_t i = 0; i < drained; ++i)
+                    {
+                        if (isValid_(burst[i]))
+                        {
+                            burst[valid++] = burst[i];
+                        }
+                    }
+                    if (valid > 0)
+                    {
+                        Backend_t::submit(burst.data(), valid);
+                    }
+                    submitted_.fetch_add(valid, std::memory_order_relaxed);
+                    dropped_.fetch_add(drained - valid, std::memory_order_relaxed);
+                }
+                else if (stopping)
+                {
+                    break;
+                }
+                else
+                {
+                    queue_.wait(WaitTimeout_);
+                }
+            }
+        }
+
+        SharedInputQueue queue_;
+        std::atomic<bool> stopping_{ false };
+        std::atomic<std::uint64_t> submitted_{ 0 };
+        std::atomic<std::uint64_t> dropped_{ 0 };
+        std::thread thread_;
+    };
+
+    using SharedInjector = SharedInjector_base<SystemBackend>;
+}
+
+#endif
+#endif
@@ -0,0 +1,375 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_STATE_HPP
+#define FI_STATE_HPP
+
+#include "config.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "event.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Number of key slots tracked by InputState */
+#ifdef UNIX
+    constexpr std::size_t KeyStateCount = 256;
+#else
+    constexpr std::size_t KeyStateCount = 512;
+#endif
+
+    /** Slot of the key in the key state bitset.
+     *
+     * The keycode on Unix. On Windows the virtual key, with extended keys
+     * in the upper half, so Enter and Numpad Enter are told apart.
+     */
+    inline std::size_t keyStateIndex(Key key)
+    {
+#ifdef UNIX
+        return key.code_;
+#else
+        return (key.virtualKey_ & 0xFF) | ((key.flags_ & KeyFlag_Extended) ? 0x100 : 0);
+#endif
+    }
+
+    /** Bit of the button in a button mask, 0 for buttons outside MouseButtonCount */
+    inline std::uint32_t buttonStateBit(MouseButton button)
+    {
+        return button >= 0 && button < MouseButtonCount ? 1u << button : 0;
+    }
+
+    /** Keys and buttons which should be held down, see InputState_base::setState().
+     *
+     * Keys are kept as they are, the backend decides their slots when
+     * the state is set.
+     */
+    class DesiredState
+    {
+    public:
+        DesiredState& press(Key key)
+        {
+            if (!isPressed(key))
+            {
+                keys_.push_back(key);
+            }
+            return *this;
+        }
+
+        DesiredState& press(MouseButton button)
+        {
+            buttons_ |= buttonStateBit(button); // unknown buttons are ignored
+            return *this;
+        }
+
+        bool isPressed(Key key) const
+        {
+            for (const Key& pressed : keys_)
+            {
+                if (pressed.virtualKey_ == key.virtualKey_ && pressed.code_ == key.code_ && pressed.flags_ == key.flags_)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool isPressed(MouseButton button) const
+        {
+            return (buttons_ & buttonStateBit(button)) != 0;
+        }
+
+    private:
+        template<typename Backend_t>
+        friend class InputState_base;
+
+        std::vector<Key> keys_;
+        std::uint32_t buttons_{};
+    };
+
+    /** Record of keys and mouse buttons held down through the backend.
+     *
+     * The backend calls track() with every event it is given, so each
+     * backend keeps its own record and setState() sends the difference
+     * back through the same backend. The record is a key bitset plus a
+     * button mask, updated with atomic operations, so it is safe to use
+     * from any thread.
+     *
+     * Keys take the slot of keyStateIndex(), unless the backend provides
+     *
+     *     static std::size_t keyStateIndex(Key key); // below KeyStateCount, 0 for <no key>
+     *
+     * If the backend provides
+     *
+     *     static std::size_t submitAtExit(const InputEvent* events, std::size_t count);
+     *
+     * everything still held is released with it when the process exits
+     * normally. Use ReleaseGuard_base to release at the end of a scope.
+     *
+     * @tparam Backend_t
+     *      Policy the events are sent through, see backend.hpp.
+     */
+    template<typename Backend_t>
+    class InputState_base
+    {
+    public:
+        static bool isPressed(Key key)
+        {
+            std::size_t index = slot_(key);
+            return (state_().keys[index / 64].load(std::memory_order_relaxed) >> (index % 64)) & 1;
+        }
+
+        static bool isPressed(MouseButton button)
+        {
+            return (state_().buttons.load(std::memory_order_relaxed) & buttonStateBit(button)) != 0;
+        }
+
+        /** Updates the record with the event, called by the backend. */
+        static void track(const InputEvent& event)
+        {
+            State_& state = state_();
+
+            switch (event.type)
+            {
+            case Event_KeyPress:
+            {
+                std::size_t index = slot_(event.key);
+                if (index != 0) {
+                    state.keyOf[index].store(pack_(event.key), std::memory_order_relaxed);
+                    state.keys[index / 64].fetch_or(std::uint64_t(1) << (index % 64), std::memory_order_relaxed);
+                }
+                break;
+            }
+            case Event_KeyRelease:
+            {
+                std::size_t index = slot_(event.key);
+                state.keys[index / 64].fetch_and(~(std::uint64_t(1) << (index % 64)), std::memory_order_relaxed);
+                break;
+            }
+            case Event_ButtonPress:
+                state.buttons.fetch_or(buttonStateBit(event.button), std::memory_order_relaxed);
+                break;
+            case Event_ButtonRelease:
+                state.buttons.fetch_and(~buttonStateBit(event.button), std::memory_order_relaxed);
+                break;
+            default:
+                break;
+            }
+        }
+
+        /** Updates the record with each of the events. */
+        static void track(const InputEvent* events, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                track(events[i]);
+            }
+        }
+
+        /** Presses and releases only what differs from the desired state.
+         *
+         * All key and button releases go before any press, the events are
+         * sent with one submission.
+         *
+         * @returns number of events the backend accepted.
+         */
+        static std::size_t setState(const DesiredState& desired)
+        {
+            std::vector<InputEvent> events;
+            appendDiff_(desired, events);
+
+            return events.empty() ? 0 : Backend_t::submit(events.data(), events.size());
+        }
+
+        /** Releases every key and button held down, with one submission.
+         *
+         * @returns number of events the backend accepted.
+         */
+        static std::size_t releaseAll()
+        {
+            return setState(DesiredState());
+        }
+
+    private:
+        template<typename T, typename = void>
+        struct ReleasesAtExit_ : std::false_type {};
+
+        template<typename T>
+        struct ReleasesAtExit_<T, std::void_t<decltype(&T::submitAtExit)>> : std::true_type {};
+
+        template<typename T, typename = void>
+        struct HasKeySlots_ : std::false_type {};
+
+        template<typename T>
+        struct HasKeySlots_<T, std::void_t<decltype(&T::keyStateIndex)>> : std::true_type {};
+
+        static std::size_t slot_(Key key)
+        {
+            if constexpr (HasKeySlots_<Backend_t>::value)
+            {
+                return Backend_t::keyStateIndex(key);
+            }
+            else
+            {
+                return keyStateIndex(key);
+            }
+        }
+
+        struct State_
+        {
+            std::atomic<std::uint64_t> keys[KeyStateCount / 64];
+            std::atomic<std::uint64_t> keyOf[KeyStateCount]; // Key last pressed in the slot
+            std::atomic<std::uint32_t> buttons;
+
+            ~State_()
+            {
+                if constexpr (ReleasesAtExit_<Backend_t>::value)
+                {
+                    // per-thread buffers and connections may be gone already
+                    std::vector<InputEvent> events;
+                    appendDiff_(DesiredState(), events);
+                    if (!events.empty())
+                    {
+                        Backend_t::submitAtExit(events.data(), events.size());
+                    }
+                }
+            }
+        };
+
+        static State_& state_()
+        {
+            static State_ state{};
+            return state;
+        }
+
+        /** Appends all releases and then all presses leading to the desired state. */
+        static void appendDiff_(const DesiredState& desired, std::vector<InputEvent>& events)
+        {
+            State_& state = state_();
+
+            std::uint64_t current[KeyStateCount / 64];
+            for (std::size_t word = 0; word < KeyStateCount / 64; ++word)
+            {
+                current[word] = state.keys[word].load(std::memory_order_relaxed);
+            }
+            std::uint32_t buttons = state.buttons.load(std::memory_order_relaxed);
+
+            std::uint64_t wanted[KeyStateCount / 64]{};
+            for (const Key& key : desired.keys_)
+            {
+                std::size_t index = slot_(key);
+                if (index != 0)
+                {
+                    wanted[index / 64] |= std::uint64_t(1) << (index % 64);
+                }
+            }
+
+            for (std::size_t word = 0; word < KeyStateCount / 64; ++word)
+            {
+                appendKeys_(current[word] & ~wanted[word], word, Event_KeyRelease, events);
+            }
+            appendButtons_(buttons & ~desired.buttons_, Event_ButtonRelease, events);
+
+            for (const Key& key : desired.keys_)
+            {
+                std::size_t index = slot_(key);
+                if (index != 0 && !((current[index / 64] >> (index % 64)) & 1))
+                {
+                    InputEvent event{};
+                    event.type = Event_KeyPress;
+                    event.key = key;
+                    events.push_back(event);
+                }
+            }
+            appendButtons_(desired.buttons_ & ~buttons, Event_ButtonPress, events);
+        }
+
+        static std::uint64_t pack_(Key key)
+        {
+            std::uint64_t packed = 0;
+            std::memcpy(&packed, &key, sizeof(Key));
+            return packed;
+        }
+
+        static Key unpack_(std::uint64_t packed)
+        {
+            Key key;
+            std::memcpy(static_cast<void*>(&key), &packed, sizeof(Key));
+            return key;
+        }
+
+        static void appendKeys_(std::uint64_t bits, std::size_t word, EventType type, std::vector<InputEvent>& events)
+        {
+            for (std::size_t bit = 0; bits != 0; ++bit, bits >>= 1)
+            {
+                if (!(bits & 1))
+                {
+                    continue;
+                }
+
+                std::size_t index = word * 64 + bit;
+                InputEvent event{};
+                event.type = type;
+                event.key = unpack_(state_().keyOf[index].load(std::memory_order_relaxed));
+                events.push_back(event);
+            }
+        }
+
+        static void appendButtons_(std::uint32_t bits, EventType type, std::vector<InputEvent>& events)
+        {
+            for (int button = 0; button < MouseButtonCount; ++button)
+            {
+                if ((bits >> button) & 1)
+                {
+                    InputEvent event{};
+                    event.type = type;
+                    event.button = static_cast<MouseButton>(button);
+                    events.push_back(event);
+                }
+            }
+        }
+    };
+
+    /** Releases all keys and buttons held down through the backend when it goes out of scope */
+    template<typename Backend_t>
+    class ReleaseGuard_base
+    {
+    public:
+        ReleaseGuard_base() = default;
+        ReleaseGuard_base(const ReleaseGuard_base&) = delete;
+        ReleaseGuard_base& operator=(const ReleaseGuard_base&) = delete;
+
+        ~ReleaseGuard_base()
+        {
+            InputState_base<Backend_t>::releaseAll();
+        }
+    };
+}
+
+#endif
@@ -36,10 +36,14 @@
 #include <Windows.h>
 #endif
 #ifdef UNIX
+#include <errno.h>
 #include <stdlib.h>
 #include <time.h>
 #endif
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include "trace.hpp"
 
 namespace FakeInput
 {
@@ -71,6 +75,9 @@ namespace FakeInput
          */
         static void wait(unsigned int milisec)
         {
+            TraceSpan span(Trace_Wait);
+            span.setDuration(static_cast<std::int64_t>(milisec) * 1000000);
+
             Sleep(milisec);
         }
 #endif
@@ -85,6 +92,9 @@ namespace FakeInput
 
         static void wait(unsigned int milisec)
         {
+            TraceSpan span(Trace_Wait);
+            span.setDuration(static_cast<std::int64_t>(milisec) * 1000000);
+
             timespec tm;
             tm.tv_sec = milisec / 1000;
             tm.tv_nsec = (milisec % 1000) * 1000000;
@@ -94,6 +104,90 @@ namespace FakeInput
 #endif
 
     };
+
+    /** Current time of the monotonic clock in nanoseconds */
+    inline std::int64_t monotonicTime()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifdef WIN32
+    /** Default time sleepUntil() spends busy-waiting before the deadline, in nanoseconds */
+    constexpr std::int64_t DefaultSpinThreshold = 1000000;
+#else
+    constexpr std::int64_t DefaultSpinThreshold = 100000;
+#endif
+
+    /** Blocks the current thread until the deadline.
+     *
+     * Sleeps while more than spinThreshold is left and busy-waits the
+     * rest, since the system sleep alone overshoots by up to a timer tick.
+     *
+     * @param deadline
+     *      Absolute monotonicTime() to wake up at.
+     * @param spinThreshold
+     *      Nanoseconds before the deadline at which to stop sleeping.
+     */
+    inline void sleepUntil(std::int64_t deadline, std::int64_t spinThreshold = DefaultSpinThreshold)
+    {
+        TraceSpan span(Trace_Wait);
+        span.setDeadline(deadline);
+        std::int64_t remaining = deadline - monotonicTime();
+
+#ifdef WIN32
+        struct WaitableTimer_
+        {
+            WaitableTimer_()
+                : handle(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS))
+            {
+            }
+
+            ~WaitableTimer_()
+            {
+                if (handle) {
+                    CloseHandle(handle);
+                }
+            }
+
+            HANDLE handle;
+        };
+
+        if (remaining > spinThreshold) {
+            static thread_local WaitableTimer_ timer;
+            std::int64_t sleepTime = remaining - spinThreshold;
+
+            LARGE_INTEGER due{};
+            due.QuadPart = -(sleepTime / 100); // relative time in 100ns units
+            if (timer.handle && SetWaitableTimer(timer.handle, &due, 0, nullptr, nullptr, FALSE)) {
+                WaitForSingleObject(timer.handle, INFINITE);
+            }
+            else {
+                Sleep(static_cast<DWORD>(sleepTime / 1000000)); // high resolution timer unavailable
+            }
+        }
+#endif
+
+#ifdef UNIX
+        if (remaining > spinThreshold)
+        {
+            std::int64_t sleepTime = remaining - spinThreshold;
+
+            timespec tm;
+            tm.tv_sec = static_cast<time_t>(sleepTime / 1000000000);
+            tm.tv_nsec = static_cast<long>(sleepTime % 1000000000);
+
+            // a signal cuts the sleep short, sleep the rest rather than spin it
+            while (nanosleep(&tm, &tm) == -1 && errno == EINTR)
+            {
+            }
+        }
+#endif
+
+        while (monotonicTime() < deadline)
+        {
+        }
+    }
 }
 
 #endif
@@ -0,0 +1,478 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_TEXT_HPP
+#define FI_TEXT_HPP
+
+#include "config.hpp"
+
+#ifdef WIN32
+#include "key_win.hpp"
+#endif
+
+#ifdef UNIX
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include "display_unix.hpp"
+#include "key_unix.hpp"
+#include "keypool_unix.hpp"
+#endif
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "backend.hpp"
+#include "event.hpp"
+#include "inject.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Decodes the code point starting at pos and moves pos past it.
+     *
+     * Malformed, overlong and surrogate sequences decode to U+FFFD and
+     * consume a single byte.
+     */
+    inline char32_t decodeUtf8(std::string_view text, std::size_t& pos)
+    {
+        constexpr char32_t replacement = 0xFFFD;
+
+        unsigned char lead = static_cast<unsigned char>(text[pos++]);
+        if (lead < 0x80)
+        {
+            return lead;
+        }
+
+        std::size_t length;
+        char32_t codePoint;
+        char32_t minimum;
+        if ((lead & 0xE0) == 0xC0) { length = 1; codePoint = lead & 0x1F; minimum = 0x80; }
+        else if ((lead & 0xF0) == 0xE0) { length = 2; codePoint = lead & 0x0F; minimum = 0x800; }
+        else if ((lead & 0xF8) == 0xF0) { length = 3; codePoint = lead & 0x07; minimum = 0x10000; }
+        else
+        {
+            return replacement;
+        }
+
+        if (text.size() - pos < length)
+        {
+            return replacement;
+        }
+
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            unsigned char next = static_cast<unsigned char>(text[pos + i]);
+            if ((next & 0xC0) != 0x80)
+            {
+                return replacement;
+            }
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+
+        if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+        {
+            return replacement;
+        }
+
+        pos += length;
+        return codePoint;
+    }
+
+    /** Modifiers a character needs to be typed with */
+    enum TextModifier : std::uint8_t
+    {
+        TextModifier_None = 0,
+        TextModifier_Shift = 1 << 0,
+        TextModifier_Control = 1 << 1,
+        TextModifier_Alt = 1 << 2 // Control with Alt is AltGr
+    };
+
+    /** Modifier keys in the order they are pressed, indexed by bit of TextModifier */
+    constexpr KeyType textModifierKeys[] = { Key_Shift_L, Key_Control_L, Key_Alt_L };
+
+    /** Key and modifiers typing a character in the current layout */
+    struct TextStroke
+    {
+        Key key; // <no key> if the layout has no key for the character
+        std::uint8_t modifiers;
+    };
+
+#ifdef WIN32
+    /** Looks characters up in the keyboard layout of the calling thread. */
+    class TextLayout
+    {
+    public:
+        TextStroke find(char32_t codePoint)
+        {
+            if (codePoint > 0xFFFF)
+            {
+                return {};
+            }
+
+            SHORT scan = VkKeyScanW(static_cast<WCHAR>(codePoint));
+            if (scan == -1 || (HIBYTE(scan) & ~7))
+            {
+                return {}; // not in the layout or needs a kana/IME modifier
+            }
+
+            // VkKeyScan shift state bits match TextModifier
+            return { CreateKeyFromKeycode(LOBYTE(scan)), static_cast<std::uint8_t>(HIBYTE(scan)) };
+        }
+    };
+#endif
+
+#ifdef UNIX
+    /** Keysym of the code point, Latin-1 keysyms equal their code points */
+    inline KeySym keysymFromCodePoint(char32_t codePoint)
+    {
+        if ((codePoint >= 0x20 && codePoint <= 0x7E) || (codePoint >= 0xA0 && codePoint <= 0xFF))
+        {
+            return codePoint;
+        }
+
+        return 0x01000000 | codePoint;
+    }
+
+    /** Snapshot of the X keyboard mapping, first two shift levels.
+     *
+     * The mapping is read with a single request, keycodes of KeycodePool
+     * are left out. Characters missing in it get remapped keys with no
+     * keycode yet, TextPlan binds them all at once through KeycodePool.
+     */
+    class TextLayout
+    {
+    public:
+        /**
+         * @param readMapping
+         *      Whether to read the X keyboard mapping, without it every
+         *      character is missing.
+         */
+        explicit TextLayout(bool readMapping = true)
+        {
+            Display* dpy = readMapping ? display() : nullptr;
+            if (!dpy)
+            {
+                return;
+            }
+
+            int minKeycode = 0;
+            int maxKeycode = 0;
+            XDisplayKeycodes(dpy, &minKeycode, &maxKeycode);
+
+            int perKeycode = 0;
+            int count = maxKeycode - minKeycode + 1;
+            KeySym* keysyms = XGetKeyboardMapping(dpy, static_cast<KeyCode>(minKeycode), count, &perKeycode);
+            if (!keysyms)
+            {
+                return;
+            }
+
+            std::bitset<256> pooled = KeycodePool::owned();
+            for (int i = count - 1; i >= 0; --i) // lowest keycode wins
+            {
+                const KeySym* entry = keysyms + i * perKeycode;
+                std::uint8_t keycode = static_cast<std::uint8_t>(minKeycode + i);
+                if (pooled.test(keycode))
+                {
+                    continue; // bound only until reused
+                }
+
+                KeySym lower = perKeycode > 0 ? entry[0] : NoSymbol;
+                KeySym upper = perKeycode > 1 ? entry[1] : NoSymbol;
+                if (upper == NoSymbol)
+                {
+                    XConvertCase(lower, &lower, &upper); // single keysym of a letter covers both cases
+                }
+
+                if (upper != NoSymbol && upper != lower)
+                {
+                    strokes_[upper] = stroke_(upper, keycode, TextModifier_Shift, KeyFlag_None);
+                }
+                if (lower != NoSymbol)
+                {
+                    strokes_[lower] = stroke_(lower, keycode, TextModifier_None, KeyFlag_None);
+                }
+            }
+
+            XFree(keysyms);
+        }
+
+        TextStroke find(char32_t codePoint)
+        {
+            KeySym keysym = keysymFromCodePoint(codePoint);
+
+            auto found = strokes_.find(keysym);
+            if (found != strokes_.end())
+            {
+                return found->second;
+            }
+
+            missing_.push_back(keysym);
+            return strokes_[keysym] = stroke_(keysym, 0, TextModifier_None, KeyFlag_Remapped);
+        }
+
+        /** Distinct key symbols found missing, in order of first use. */
+        const std::vector<KeySym>& missing() const
+        {
+            return missing_;
+        }
+
+    private:
+        static TextStroke stroke_(KeySym keysym, std::uint8_t keycode, std::uint8_t modifiers, std::uint8_t flags)
+        {
+            Key key{};
+            key.virtualKey_ = static_cast<std::uint32_t>(keysym);
+            key.code_ = keycode;
+            key.flags_ = flags;
+            return { key, modifiers };
+        }
+
+        std::unordered_map<KeySym, TextStroke> strokes_;
+        std::vector<KeySym> missing_;
+    };
+#endif
+
+    /** Key events typing a text, compiled once and replayable.
+     *
+     * The text is looked up in the current keyboard layout when the plan
+     * is compiled. Modifiers are pressed only when the next character
+     * needs a different set, so a run of capitals holds Shift once.
+     * Characters missing in the layout are sent as KEYEVENTF_UNICODE
+     * events on Windows. On X11 they are bound to spare keycodes of
+     * KeycodePool, with one mapping change for the whole text, and bound
+     * again before every submission in case the keycodes were reused.
+     * Recompile the plan after the layout changes.
+     *
+     * Unless UsesSystemLayout holds for the backend, the X keyboard
+     * mapping is neither read nor changed. Characters other than control
+     * characters then keep their keysym in the remapped keys, with keycode 0.
+     *
+     * @tparam Backend_t
+     *      Where the events go, see SystemBackend.
+     */
+    template<typename Backend_t>
+    class TextPlan_base
+    {
+    public:
+        TextPlan_base() = default;
+
+        explicit TextPlan_base(std::string_view utf8)
+        {
+            compile(utf8);
+        }
+
+        /** Replaces the plan with events typing the UTF-8 text. */
+        void compile(std::string_view utf8)
+        {
+            events_.clear();
+            modifiers_ = TextModifier_None;
+
+#ifdef UNIX
+            TextLayout layout(UsesSystemLayout<Backend_t>::value);
+#else
+            TextLayout layout;
+#endif
+            for (std::size_t pos = 0; pos < utf8.size();)
+            {
+                char32_t codePoint = decodeUtf8(utf8, pos);
+
+                if (codePoint == '\r' && pos < utf8.size() && utf8[pos] == '\n')
+                {
+                    continue; // CR LF is a single Return
+                }
+
+                TextStroke stroke = control_(codePoint);
+                if (stroke.key.virtualKey_ == 0)
+                {
+                    stroke = layout.find(codePoint);
+                }
+
+#ifdef WIN32
+                if (stroke.key.virtualKey_ == 0)
+                {
+                    addUnicode_(codePoint);
+                    continue;
+                }
+#endif
+
+                setModifiers_(stroke.modifiers);
+                addKey_(stroke.key, Event_KeyPress);
+                addKey_(stroke.key, Event_KeyRelease);
+            }
+
+            setModifiers_(TextModifier_None);
+
+#ifdef UNIX
+            remapped_ = layout.missing();
+            bindRemapped_();
+#endif
+        }
+
+        const std::vector<InputEvent>& events() const
+        {
+            return events_;
+        }
+
+        std::size_t size() const
+        {
+            return events_.size();
+        }
+
+        bool empty() const
+        {
+            return events_.empty();
+        }
+
+        /** Types the text with a single submission.
+         *
+         * @returns number of events the backend accepted.
+         */
+        std::size_t submit()
+        {
+#ifdef UNIX
+            bindRemapped_();
+#endif
+            return events_.empty() ? 0 : Backend_t::submit(events_.data(), events_.size());
+        }
+
+    private:
+        /** Keys of control characters, which the layout lookup gets wrong. */
+        static TextStroke control_(char32_t codePoint)
+        {
+            switch (codePoint)
+            {
+            case '\r':
+            case '\n':
+                return { CreateKeyFromKeyType(Key_Return), TextModifier_None };
+            case '\t':
+                return { CreateKeyFromKeyType(Key_Tab), TextModifier_None };
+            case '\b':
+                return { CreateKeyFromKeyType(Key_Backspace), TextModifier_None };
+            default:
+                return {};
+            }
+        }
+
+        /** Presses and releases modifiers differing from the current set. */
+        void setModifiers_(std::uint8_t modifiers)
+        {
+            std::uint8_t changed = modifiers_ ^ modifiers;
+            for (std::size_t bit = 0; changed != 0; ++bit, changed >>= 1)
+            {
+                if (changed & 1)
+                {
+                    bool isPress = (modifiers >> bit) & 1;
+                    addKey_(CreateKeyFromKeyType(textModifierKeys[bit]), isPress ? Event_KeyPress : Event_KeyRelease);
+                }
+            }
+
+            modifiers_ = modifiers;
+        }
+
+        void addKey_(Key key, EventType type)
+        {
+            InputEvent event{};
+            event.type = type;
+            event.key = key;
+            events_.push_back(event);
+        }
+
+#ifdef WIN32
+        void addUnicode_(char32_t codePoint)
+        {
+            setModifiers_(TextModifier_None);
+
+            // UTF-16 code units, a surrogate pair above the BMP
+            WORD units[2];
+            std::size_t count = 1;
+            if (codePoint > 0xFFFF)
+            {
+                codePoint -= 0x10000;
+                units[0] = static_cast<WORD>(0xD800 | (codePoint >> 10));
+                units[1] = static_cast<WORD>(0xDC00 | (codePoint & 0x3FF));
+                count = 2;
+            }
+            else
+            {
+                units[0] = static_cast<WORD>(codePoint);
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                InputEvent event{};
+                event.type = Event_UnicodePress;
+                event.x = units[i];
+                events_.push_back(event);
+
+                event.type = Event_UnicodeRelease;
+                events_.push_back(event);
+            }
+        }
+#endif
+
+#ifdef UNIX
+        /** Binds the remapped key symbols and patches their keycodes into the events. */
+        void bindRemapped_()
+        {
+            if (!UsesSystemLayout<Backend_t>::value || remapped_.empty())
+            {
+                return;
+            }
+
+            std::vector<std::uint8_t> keycodes(remapped_.size());
+            if (KeycodePool::bind(remapped_.data(), remapped_.size(), keycodes.data()) < remapped_.size())
+            {
+                std::cerr << "Not enough spare keycodes to type the text" << std::endl;
+            }
+
+            std::unordered_map<KeySym, std::uint8_t> keycodeOf;
+            for (std::size_t i = 0; i < remapped_.size(); ++i)
+            {
+                keycodeOf[remapped_[i]] = keycodes[i];
+            }
+
+            for (InputEvent& event : events_)
+            {
+                if (event.key.flags_ & KeyFlag_Remapped)
+                {
+                    event.key.code_ = keycodeOf[event.key.virtualKey_]; // 0 is skipped when sent
+                }
+            }
+        }
+
+        std::vector<KeySym> remapped_;
+#endif
+
+        std::vector<InputEvent> events_;
+        std::uint8_t modifiers_ = TextModifier_None;
+    };
+
+    using TextPlan = TextPlan_base<SystemBackend>;
+}
+
+#endif
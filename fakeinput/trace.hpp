@@ -0,0 +1,350 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_TRACE_HPP
+#define FI_TRACE_HPP
+
+#include "config.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#ifdef FAKEINPUT_TRACE
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace FakeInput
+{
+    /** Kinds of spans recorded by Tracer */
+    enum TraceKind : std::uint8_t
+    {
+        Trace_Enqueue, // Injector::post()
+        Trace_Wait, // System::wait() and sleepUntil()
+        Trace_Submit, // submitEvents(), events built and sent
+        Trace_Flush, // SendInput call or XFlush
+        TraceKindCount
+    };
+
+    /** Span names in the trace, indexed by TraceKind */
+    constexpr const char* traceKindNames[] = { "enqueue", "wait", "submit", "flush" };
+
+    /** Names of the span value in the trace, indexed by TraceKind */
+    constexpr const char* traceValueNames[] = { "events", "late_ns", "events", "events" };
+
+    static_assert(sizeof(traceKindNames) / sizeof(*traceKindNames) == TraceKindCount
+        && sizeof(traceValueNames) / sizeof(*traceValueNames) == TraceKindCount,
+        "trace names must cover every TraceKind");
+
+#ifndef FAKEINPUT_TRACE_CAPACITY
+    /** Spans kept per thread, older ones are overwritten */
+    #define FAKEINPUT_TRACE_CAPACITY 65536
+#endif
+
+#ifdef FAKEINPUT_TRACE
+    constexpr bool TraceEnabled = true;
+
+    /** Timeline of the injection path in Chrome trace format.
+     *
+     * Every thread records its spans into a ring of its own, taken when
+     * the thread records its first span, so recording takes two clock
+     * reads and a few stores. When a ring is full the oldest spans are
+     * overwritten. Rings of exited threads are taken over by new threads,
+     * so their spans stay until overwritten and the memory stays bounded
+     * by the number of threads alive at once. save() writes the spans of all threads as
+     * Chrome trace JSON, which chrome://tracing and the Perfetto UI open.
+     *
+     * Enabled by defining FAKEINPUT_TRACE, see config.hpp. Otherwise
+     * TraceSpan is empty and save() writes nothing.
+     */
+    class Tracer
+    {
+    public:
+        /** Clock of the timestamps in nanoseconds, same as monotonicTime() */
+        static std::int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /** Records finished span of the calling thread. */
+        static void record(TraceKind kind, std::int64_t start, std::int64_t end, std::int64_t value)
+        {
+            Ring_& ring = threadRing_();
+            std::uint64_t written = ring.written.load(std::memory_order_relaxed);
+
+            Span_& span = ring.spans[written % FAKEINPUT_TRACE_CAPACITY];
+            span.start = start;
+            span.duration = end - start;
+            span.value = value;
+            span.kind = kind;
+
+            ring.written.store(written + 1, std::memory_order_release);
+        }
+
+        /** Writes spans of all threads as Chrome trace JSON.
+         *
+         * Call it when the traced threads are idle, e.g. at the end of the
+         * run, spans recorded meanwhile may be torn.
+         */
+        static bool writeTo(std::FILE* file)
+        {
+            std::lock_guard<std::mutex> lock(registry_().mutex);
+
+            bool isFirst = true;
+            auto separate = [&] {
+                std::fputs(isFirst ? "\n" : ",\n", file);
+                isFirst = false;
+            };
+
+            std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+            for (const std::unique_ptr<Ring_>& ring : registry_().rings)
+            {
+                separate();
+                std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"fakeinput %u\"}}",
+                    ring->id, ring->id);
+
+                std::uint64_t written = ring->written.load(std::memory_order_acquire);
+                std::uint64_t first = written > FAKEINPUT_TRACE_CAPACITY ? written - FAKEINPUT_TRACE_CAPACITY : 0;
+                for (std::uint64_t i = first; i < written; ++i)
+                {
+                    const Span_& span = ring->spans[i % FAKEINPUT_TRACE_CAPACITY];
+                    separate();
+                    std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"fakeinput\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%lld}}",
+                        traceKindNames[span.kind], ring->id, span.start / 1000.0, span.duration / 1000.0,
+                        traceValueNames[span.kind], static_cast<long long>(span.value));
+                }
+            }
+            std::fputs("\n]}\n", file);
+
+            return !std::ferror(file);
+        }
+
+        /** Writes spans of all threads into the file, see writeTo(). */
+        static bool save(const std::string& path)
+        {
+            std::FILE* file = std::fopen(path.c_str(), "w");
+            if (!file)
+            {
+                return false;
+            }
+
+            bool isWritten = writeTo(file);
+            return std::fclose(file) == 0 && isWritten;
+        }
+
+        /** Forgets recorded spans, call it when the traced threads are idle. */
+        static void clear()
+        {
+            std::lock_guard<std::mutex> lock(registry_().mutex);
+            for (const std::unique_ptr<Ring_>& ring : registry_().rings)
+            {
+                ring->written.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        struct Span_
+        {
+            std::int64_t start;
+            std::int64_t duration;
+            std::int64_t value;
+            TraceKind kind;
+        };
+
+        struct Ring_
+        {
+            std::unique_ptr<Span_[]> spans{ new Span_[FAKEINPUT_TRACE_CAPACITY] };
+            std::atomic<std::uint64_t> written{ 0 };
+            unsigned id = 0;
+            bool isUsed = true; // guarded by the registry mutex
+        };
+
+        struct Registry_
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<Ring_>> rings; // kept after their thread exits
+        };
+
+        /** Returns ring to the registry when its thread exits */
+        struct ThreadSlot_
+        {
+            Ring_* ring = nullptr;
+
+            ~ThreadSlot_()
+            {
+                if (ring)
+                {
+                    std::lock_guard<std::mutex> lock(registry_().mutex);
+                    ring->isUsed = false;
+                }
+            }
+        };
+
+        static Ring_& threadRing_()
+        {
+            static thread_local ThreadSlot_ slot;
+            if (!slot.ring)
+            {
+                slot.ring = acquireRing_();
+            }
+            return *slot.ring;
+        }
+
+        static Ring_* acquireRing_()
+        {
+            Registry_& registry = registry_();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (const std::unique_ptr<Ring_>& ring : registry.rings)
+            {
+                if (!ring->isUsed)
+                {
+                    ring->isUsed = true;
+                    return ring.get();
+                }
+            }
+
+            registry.rings.emplace_back(new Ring_);
+            registry.rings.back()->id = static_cast<unsigned>(registry.rings.size());
+            return registry.rings.back().get();
+        }
+
+        static Registry_& registry_()
+        {
+            // never destroyed, threads may record while the process exits
+            static Registry_* registry = new Registry_;
+            return *registry;
+        }
+    };
+
+    /** Records the scope as a span of the calling thread */
+    class TraceSpan
+    {
+    public:
+        explicit TraceSpan(TraceKind kind, std::int64_t value = 0)
+            : kind_(kind), value_(value), start_(Tracer::now())
+        {
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        ~TraceSpan()
+        {
+            std::int64_t end = Tracer::now();
+            Tracer::record(kind_, start_, end, hasDeadline_ ? end - deadline_ : value_);
+        }
+
+        void setValue(std::int64_t value)
+        {
+            value_ = value;
+        }
+
+        /** Makes the value how late the span ends past the deadline, in nanoseconds.
+         *
+         * @param deadline
+         *      Absolute time of Tracer::now().
+         */
+        void setDeadline(std::int64_t deadline)
+        {
+            deadline_ = deadline;
+            hasDeadline_ = true;
+        }
+
+        /** Same as setDeadline() with the deadline duration nanoseconds after the span started. */
+        void setDuration(std::int64_t duration)
+        {
+            setDeadline(start_ + duration);
+        }
+
+    private:
+        TraceKind kind_;
+        std::int64_t value_;
+        std::int64_t start_;
+        std::int64_t deadline_ = 0;
+        bool hasDeadline_ = false;
+    };
+#else
+    constexpr bool TraceEnabled = false;
+
+    class Tracer
+    {
+    public:
+        static std::int64_t now()
+        {
+            return 0;
+        }
+
+        static void record(TraceKind, std::int64_t, std::int64_t, std::int64_t)
+        {
+        }
+
+        /** @returns false, tracing is disabled. */
+        static bool writeTo(std::FILE*)
+        {
+            return false;
+        }
+
+        /** @returns false, tracing is disabled. */
+        static bool save(const std::string&)
+        {
+            return false;
+        }
+
+        static void clear()
+        {
+        }
+    };
+
+    class TraceSpan
+    {
+    public:
+        explicit TraceSpan(TraceKind, std::int64_t = 0)
+        {
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        void setValue(std::int64_t)
+        {
+        }
+
+        void setDeadline(std::int64_t)
+        {
+        }
+
+        void setDuration(std::int64_t)
+        {
+        }
+    };
+#endif
+}
+
+#endif
@@ -25,6 +25,8 @@
 #ifndef FI_TYPES_HPP
 #define FI_TYPES_HPP
 
+#include <cstddef>
+
 namespace FakeInput
 {
     /** Mouse button which can be pressed or released */
@@ -111,6 +113,50 @@ namespace FakeInput
         Key_VolumeDown,
         Key_VolumeMute
     };
+
+    /** Number of mouse buttons */
+    constexpr int MouseButtonCount = Mouse_Right + 1;
+
+    /** Number of key types, Key_NoKey excluded */
+    constexpr int KeyTypeCount = Key_VolumeMute + 1;
+
+    /** Entry of a compile-time table translating enum values to platform codes
+     *
+     * Tables are indexed by the enum value, the enumerator is stored only
+     * to check the table order at compile time.
+     */
+    template<typename Enum_t, typename Code_t>
+    struct TranslationEntry
+    {
+        Enum_t value;
+        Code_t code;
+    };
+
+    /** Checks that the table has exactly one non-zero entry for each enum value, in order.
+     *
+     * @param table
+     *      Translation table to check.
+     * @param count
+     *      Number of enum values the table must cover.
+     */
+    template<typename Enum_t, typename Code_t, std::size_t N>
+    constexpr bool coversAllValues(const TranslationEntry<Enum_t, Code_t> (&table)[N], int count)
+    {
+        if (static_cast<int>(N) != count)
+        {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            if (static_cast<std::size_t>(table[i].value) != i || table[i].code == 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
 }
 
 #endif
@@ -0,0 +1,629 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FI_UINPUT_LINUX_HPP
+#define FI_UINPUT_LINUX_HPP
+
+#include "config.hpp"
+#if defined(UNIX) && defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "event.hpp"
+#include "key_unix.hpp"
+#include "screen.hpp"
+#include "state.hpp"
+#include "system.hpp"
+#include "types.hpp"
+
+namespace FakeInput
+{
+    /** Evdev button codes, indexed by MouseButton */
+    constexpr TranslationEntry<MouseButton, std::uint16_t> evdevButtonTable[] =
+    {
+        { MouseButton::Mouse_Left, BTN_LEFT },
+        { MouseButton::Mouse_Middle, BTN_MIDDLE },
+        { MouseButton::Mouse_Right, BTN_RIGHT }
+    };
+
+    static_assert(coversAllValues(evdevButtonTable, MouseButtonCount),
+        "evdevButtonTable must map every MouseButton, in declaration order");
+
+    /** Evdev key codes of the key types, indexed by KeyType */
+    constexpr TranslationEntry<KeyType, std::uint16_t> evdevKeyTable[] =
+    {
+        { KeyType::Key_A, KEY_A },
+        { KeyType::Key_B, KEY_B },
+        { KeyType::Key_C, KEY_C },
+        { KeyType::Key_D, KEY_D },
+        { KeyType::Key_E, KEY_E },
+        { KeyType::Key_F, KEY_F },
+        { KeyType::Key_G, KEY_G },
+        { KeyType::Key_H, KEY_H },
+        { KeyType::Key_I, KEY_I },
+        { KeyType::Key_J, KEY_J },
+        { KeyType::Key_K, KEY_K },
+        { KeyType::Key_L, KEY_L },
+        { KeyType::Key_M, KEY_M },
+        { KeyType::Key_N, KEY_N },
+        { KeyType::Key_O, KEY_O },
+        { KeyType::Key_P, KEY_P },
+        { KeyType::Key_Q, KEY_Q },
+        { KeyType::Key_R, KEY_R },
+        { KeyType::Key_S, KEY_S },
+        { KeyType::Key_T, KEY_T },
+        { KeyType::Key_U, KEY_U },
+        { KeyType::Key_V, KEY_V },
+        { KeyType::Key_W, KEY_W },
+        { KeyType::Key_X, KEY_X },
+        { KeyType::Key_Y, KEY_Y },
+        { KeyType::Key_Z, KEY_Z },
+        { KeyType::Key_0, KEY_0 },
+        { KeyType::Key_1, KEY_1 },
+        { KeyType::Key_2, KEY_2 },
+        { KeyType::Key_3, KEY_3 },
+        { KeyType::Key_4, KEY_4 },
+        { KeyType::Key_5, KEY_5 },
+        { KeyType::Key_6, KEY_6 },
+        { KeyType::Key_7, KEY_7 },
+        { KeyType::Key_8, KEY_8 },
+        { KeyType::Key_9, KEY_9 },
+        { KeyType::Key_F1, KEY_F1 },
+        { KeyType::Key_F2, KEY_F2 },
+        { KeyType::Key_F3, KEY_F3 },
+        { KeyType::Key_F4, KEY_F4 },
+        { KeyType::Key_F5, KEY_F5 },
+        { KeyType::Key_F6, KEY_F6 },
+        { KeyType::Key_F7, KEY_F7 },
+        { KeyType::Key_F8, KEY_F8 },
+        { KeyType::Key_F9, KEY_F9 },
+        { KeyType::Key_F10, KEY_F10 },
+        { KeyType::Key_F11, KEY_F11 },
+        { KeyType::Key_F12, KEY_F12 },
+        { KeyType::Key_F13, KEY_F13 },
+        { KeyType::Key_F14, KEY_F14 },
+        { KeyType::Key_F15, KEY_F15 },
+        { KeyType::Key_F16, KEY_F16 },
+        { KeyType::Key_F17, KEY_F17 },
+        { KeyType::Key_F18, KEY_F18 },
+        { KeyType::Key_F19, KEY_F19 },
+        { KeyType::Key_F20, KEY_F20 },
+        { KeyType::Key_F21, KEY_F21 },
+        { KeyType::Key_F22, KEY_F22 },
+        { KeyType::Key_F23, KEY_F23 },
+        { KeyType::Key_F24, KEY_F24 },
+        { KeyType::Key_Escape, KEY_ESC },
+        { KeyType::Key_Space, KEY_SPACE },
+        { KeyType::Key_Return, KEY_ENTER },
+        { KeyType::Key_Backspace, KEY_BACKSPACE },
+        { KeyType::Key_Tab, KEY_TAB },
+        { KeyType::Key_Shift_L, KEY_LEFTSHIFT },
+        { KeyType::Key_Shift_R, KEY_RIGHTSHIFT },
+        { KeyType::Key_Control_L, KEY_LEFTCTRL },
+        { KeyType::Key_Control_R, KEY_RIGHTCTRL },
+        { KeyType::Key_Alt_L, KEY_LEFTALT },
+        { KeyType::Key_Alt_R, KEY_RIGHTALT },
+        { KeyType::Key_Win_L, KEY_LEFTMETA },
+        { KeyType::Key_Win_R, KEY_RIGHTMETA },
+        { KeyType::Key_Apps, KEY_COMPOSE },
+        { KeyType::Key_CapsLock, KEY_CAPSLOCK },
+        { KeyType::Key_NumLock, KEY_NUMLOCK },
+        { KeyType::Key_ScrollLock, KEY_SCROLLLOCK },
+        { KeyType::Key_PrintScreen, KEY_SYSRQ },
+        { KeyType::Key_Pause, KEY_PAUSE },
+        { KeyType::Key_Insert, KEY_INSERT },
+        { KeyType::Key_Delete, KEY_DELETE },
+        { KeyType::Key_PageUP, KEY_PAGEUP },
+        { KeyType::Key_PageDown, KEY_PAGEDOWN },
+        { KeyType::Key_Home, KEY_HOME },
+        { KeyType::Key_End, KEY_END },
+        { KeyType::Key_Left, KEY_LEFT },
+        { KeyType::Key_Right, KEY_RIGHT },
+        { KeyType::Key_Up, KEY_UP },
+        { KeyType::Key_Down, KEY_DOWN },
+        { KeyType::Key_Numpad0, KEY_KP0 },
+        { KeyType::Key_Numpad1, KEY_KP1 },
+        { KeyType::Key_Numpad2, KEY_KP2 },
+        { KeyType::Key_Numpad3, KEY_KP3 },
+        { KeyType::Key_Numpad4, KEY_KP4 },
+        { KeyType::Key_Numpad5, KEY_KP5 },
+        { KeyType::Key_Numpad6, KEY_KP6 },
+        { KeyType::Key_Numpad7, KEY_KP7 },
+        { KeyType::Key_Numpad8, KEY_KP8 },
+        { KeyType::Key_Numpad9, KEY_KP9 },
+        { KeyType::Key_NumpadAdd, KEY_KPPLUS },
+        { KeyType::Key_NumpadSubtract, KEY_KPMINUS },
+        { KeyType::Key_NumpadMultiply, KEY_KPASTERISK },
+        { KeyType::Key_NumpadDivide, KEY_KPSLASH },
+        { KeyType::Key_NumpadDecimal, KEY_KPDOT },
+        { KeyType::Key_NumpadEnter, KEY_KPENTER },
+        { KeyType::Key_MediaPlayPause, KEY_PLAYPAUSE },
+        { KeyType::Key_MediaNext, KEY_NEXTSONG },
+        { KeyType::Key_MediaPrev, KEY_PREVIOUSSONG },
+        { KeyType::Key_MediaStop, KEY_STOPCD },
+        { KeyType::Key_VolumeUp, KEY_VOLUMEUP },
+        { KeyType::Key_VolumeDown, KEY_VOLUMEDOWN },
+        { KeyType::Key_VolumeMute, KEY_MUTE }
+    };
+
+    static_assert(coversAllValues(evdevKeyTable, KeyTypeCount),
+        "evdevKeyTable must map every KeyType, in declaration order");
+
+    /** X keycodes are evdev key codes shifted by 8 */
+    constexpr unsigned EvdevKeycodeOffset = 8;
+
+    /** Key symbol and its evdev key code */
+    struct EvdevKeysym
+    {
+        std::uint32_t keysym;
+        std::uint16_t code;
+    };
+
+    /** Evdev key codes of the key type symbols and lowercase letters, sorted by key symbol */
+    constexpr std::array<EvdevKeysym, KeyTypeCount + 26> evdevKeysymTable = [] {
+        std::array<EvdevKeysym, KeyTypeCount + 26> table{};
+        for (int type = 0; type < KeyTypeCount; ++type)
+        {
+            table[type] = EvdevKeysym{ keyTypeTable[type].code, evdevKeyTable[type].code };
+        }
+        for (int letter = 0; letter < 26; ++letter)
+        {
+            table[KeyTypeCount + letter] = EvdevKeysym{ XK_a + static_cast<std::uint32_t>(letter), evdevKeyTable[Key_A + letter].code };
+        }
+
+        // insertion sort, std::sort is not constexpr before C++20
+        for (std::size_t i = 1; i < table.size(); ++i)
+        {
+            EvdevKeysym entry = table[i];
+            std::size_t at = i;
+            for (; at > 0 && table[at - 1].keysym > entry.keysym; --at)
+            {
+                table[at] = table[at - 1];
+            }
+            table[at] = entry;
+        }
+        return table;
+    }();
+
+    /** Translates key to the evdev key code.
+     *
+     * Keys of the key types are found by their key symbol, lowercase
+     * letters included, which needs no X server. Other keys fall back
+     * to the X keycode minus 8.
+     *
+     * @returns evdev key code or 0 for <no key>.
+     */
+    inline std::uint16_t translateEvdevKey(Key key)
+    {
+        std::uint32_t keysym = static_cast<std::uint32_t>(key.virtualKey_);
+        const EvdevKeysym* found = std::lower_bound(evdevKeysymTable.begin(), evdevKeysymTable.end(), keysym,
+            [](const EvdevKeysym& entry, std::uint32_t value) { return entry.keysym < value; });
+        if (found != evdevKeysymTable.end() && found->keysym == keysym)
+        {
+            return found->code;
+        }
+
+        return key.code_ > EvdevKeycodeOffset ? static_cast<std::uint16_t>(key.code_ - EvdevKeycodeOffset) : 0;
+    }
+
+    /** Virtual keyboard and mouse created through uinput.
+     *
+     * Works without any X server, under Wayland, on consoles and in
+     * containers. The events of a submission are converted to an array
+     * of input_event, each event closed by SYN_REPORT, and written with a
+     * single write(). Delays split the submission into frames which are
+     * written at their deadlines.
+     *
+     * Keys are translated by translateEvdevKey(). Absolute moves use
+     * ABS_X and ABS_Y, in the 0-65535 range of the virtual desktop by
+     * default. Set the screen size with setScreenSize() to make the axes
+     * span its pixels, otherwise Event_MoveTo is normalized through
+     * ScreenGeometry, which needs the X server.
+     *
+     * Writes block until the device takes the events. Destroying the
+     * device releases the keys and buttons it holds.
+     *
+     * @warning @image html tux.png
+     *    Linux only
+     */
+    class UinputDevice
+    {
+    public:
+        UinputDevice() = default;
+
+        ~UinputDevice()
+        {
+            close();
+        }
+
+        UinputDevice(const UinputDevice&) = delete;
+        UinputDevice& operator=(const UinputDevice&) = delete;
+
+        /** Creates the virtual device, replacing the current one.
+         *
+         * @param path
+         *      uinput device node.
+         * @param name
+         *      Name the device is announced with.
+         *
+         * @returns false if uinput is not accessible.
+         */
+        bool create(const char* path = "/dev/uinput", const char* name = "FakeInput virtual device")
+        {
+            close();
+
+            int fd = ::open(path, O_WRONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                std::cerr << "Cannot open " << path << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+
+            int width = 0;
+            int height = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                width = width_;
+                height = height_;
+            }
+
+            bool isSetUp = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0
+                && ioctl(fd, UI_SET_EVBIT, EV_REL) == 0
+                && ioctl(fd, UI_SET_EVBIT, EV_ABS) == 0
+                && ioctl(fd, UI_SET_EVBIT, EV_SYN) == 0
+                && ioctl(fd, UI_SET_RELBIT, REL_X) == 0
+                && ioctl(fd, UI_SET_RELBIT, REL_Y) == 0
+                && ioctl(fd, UI_SET_RELBIT, REL_WHEEL) == 0;
+
+            for (int key = KEY_ESC; isSetUp && key < 256; ++key)
+            {
+                isSetUp = ioctl(fd, UI_SET_KEYBIT, key) == 0;
+            }
+            for (const auto& button : evdevButtonTable)
+            {
+                isSetUp = isSetUp && ioctl(fd, UI_SET_KEYBIT, button.code) == 0;
+            }
+
+            for (int axis : { ABS_X, ABS_Y })
+            {
+                uinput_abs_setup abs{};
+                abs.code = static_cast<std::uint16_t>(axis);
+                abs.absinfo.maximum = axisMax_(axis == ABS_X ? width : height);
+                isSetUp = isSetUp && ioctl(fd, UI_SET_ABSBIT, axis) == 0 && ioctl(fd, UI_ABS_SETUP, &abs) == 0;
+            }
+
+            uinput_setup setup{};
+            setup.id.bustype = BUS_VIRTUAL;
+            setup.id.vendor = 0x1;
+            setup.id.product = 0x1;
+            std::strncpy(setup.name, name, UINPUT_MAX_NAME_SIZE - 1);
+
+            isSetUp = isSetUp && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+            if (!isSetUp)
+            {
+                std::cerr << "Cannot create uinput device: " << std::strerror(errno) << std::endl;
+                ::close(fd);
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            fd_ = fd;
+            isOwned_ = true;
+            isDevice_ = true;
+            return true;
+        }
+
+        /** Writes to the file descriptor instead of a uinput device.
+         *
+         * Nothing is set up on it, a pipe or a file receives the plain
+         * input_event stream, which lets tests check it without privileges.
+         *
+         * @param fd
+         *      Writable file descriptor.
+         * @param owns
+         *      Whether close() closes the descriptor.
+         */
+        void attach(int fd, bool owns = false)
+        {
+            close();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            fd_ = fd;
+            isOwned_ = owns;
+            isDevice_ = false;
+        }
+
+        /** Sets the screen size the absolute axes span, call before create().
+         *
+         * Event_MoveTo then needs no X server, its coordinates are sent as
+         * they are. Normalized moves are scaled to the size.
+         *
+         * @param width
+         *      Screen width in pixels, 0 for the normalized range.
+         * @param height
+         *      Screen height in pixels, 0 for the normalized range.
+         */
+        void setScreenSize(int width, int height)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            width_ = width > 0 && height > 0 ? width : 0;
+            height_ = width > 0 && height > 0 ? height : 0;
+        }
+
+        /** Destroys the device, or detaches the file descriptor. */
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd_ < 0)
+            {
+                return;
+            }
+
+            if (isDevice_)
+            {
+                ioctl(fd_, UI_DEV_DESTROY);
+            }
+            if (isOwned_)
+            {
+                ::close(fd_);
+            }
+            fd_ = -1;
+        }
+
+        bool isOpen()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return fd_ >= 0;
+        }
+
+        /** Sends events, with one write() per frame.
+         *
+         * @returns number of events written.
+         */
+        std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd_ < 0)
+            {
+                return 0;
+            }
+
+            frame_.clear();
+            std::size_t framed = 0;
+            std::size_t sent = 0;
+            std::int64_t deadline = 0;
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const InputEvent& event = events[i];
+
+                if (event.delay > 0)
+                {
+                    sent += write_() ? framed : 0;
+                    framed = 0;
+
+                    std::int64_t now = monotonicTime();
+                    deadline = (deadline > now ? deadline : now) + static_cast<std::int64_t>(event.delay) * 1000000;
+                    sleepUntil(deadline);
+                }
+
+                if (append_(event))
+                {
+                    append_(EV_SYN, SYN_REPORT, 0);
+                    ++framed;
+                }
+            }
+
+            return sent + (write_() ? framed : 0);
+        }
+
+    private:
+        /** Appends input_events of the event, returns false if it has none. */
+        bool append_(const InputEvent& event)
+        {
+            switch (event.type)
+            {
+            case Event_KeyPress:
+            case Event_KeyRelease:
+            {
+                std::uint16_t code = translateEvdevKey(event.key);
+                if (code == 0)
+                {
+                    return false; // <no key>
+                }
+                append_(EV_KEY, code, event.type == Event_KeyPress);
+                return true;
+            }
+            case Event_ButtonPress:
+            case Event_ButtonRelease:
+                if (event.button < 0 || event.button >= MouseButtonCount)
+                {
+                    return false;
+                }
+                append_(EV_KEY, evdevButtonTable[event.button].code, event.type == Event_ButtonPress);
+                return true;
+            case Event_Move:
+                if (event.x != 0)
+                {
+                    append_(EV_REL, REL_X, event.x);
+                }
+                if (event.y != 0)
+                {
+                    append_(EV_REL, REL_Y, event.y);
+                }
+                return event.x != 0 || event.y != 0;
+            case Event_MoveTo:
+                if (width_ > 0)
+                {
+                    append_(EV_ABS, ABS_X, clamp_(event.x, axisMax_(width_)));
+                    append_(EV_ABS, ABS_Y, clamp_(event.y, axisMax_(height_)));
+                }
+                else
+                {
+                    append_(EV_ABS, ABS_X, ScreenGeometry::normalizeX(event.x));
+                    append_(EV_ABS, ABS_Y, ScreenGeometry::normalizeY(event.y));
+                }
+                return true;
+            case Event_MoveToNormalized:
+                append_(EV_ABS, ABS_X, scale_(event.x, axisMax_(width_)));
+                append_(EV_ABS, ABS_Y, scale_(event.y, axisMax_(height_)));
+                return true;
+            case Event_Wheel:
+                append_(EV_REL, REL_WHEEL, event.y);
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /** Maximum of the axis spanning the size, the normalized one for 0 */
+        static int axisMax_(int size)
+        {
+            return size > 0 ? size - 1 : ScreenGeometry::NormalizedMax;
+        }
+
+        static int clamp_(int value, int max)
+        {
+            return value < 0 ? 0 : (value > max ? max : value);
+        }
+
+        /** Scales the normalized coordinate to the axis, rounding to nearest */
+        static int scale_(int normalized, int max)
+        {
+            std::int64_t scaled = (static_cast<std::int64_t>(clamp_(normalized, ScreenGeometry::NormalizedMax)) * max
+                + ScreenGeometry::NormalizedMax / 2) / ScreenGeometry::NormalizedMax;
+            return static_cast<int>(scaled);
+        }
+
+        void append_(std::uint16_t type, std::uint16_t code, std::int32_t value)
+        {
+            input_event event{}; // the kernel fills in the time
+            event.type = type;
+            event.code = code;
+            event.value = value;
+            frame_.push_back(event);
+        }
+
+        /** Writes the frame and clears it, returns false on error. */
+        bool write_()
+        {
+            const char* data = reinterpret_cast<const char*>(frame_.data());
+            std::size_t left = frame_.size() * sizeof(input_event);
+            frame_.clear();
+
+            while (left > 0)
+            {
+                ssize_t written = ::write(fd_, data, left);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        // non-blocking descriptor, wait until it takes more
+                        pollfd writable{ fd_, POLLOUT, 0 };
+                        if (::poll(&writable, 1, -1) >= 0 || errno == EINTR)
+                        {
+                            continue;
+                        }
+                    }
+                    std::cerr << "Cannot write input events: " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+
+                data += written;
+                left -= static_cast<std::size_t>(written);
+            }
+
+            return true;
+        }
+
+        std::mutex mutex_;
+        int fd_ = -1;
+        bool isOwned_ = false;
+        bool isDevice_ = false;
+        int width_ = 0; // 0 for the normalized range
+        int height_ = 0;
+        std::vector<input_event> frame_;
+    };
+
+    /** Sends events through a process-wide UinputDevice.
+     *
+     * The device is created on the first submission unless device()
+     * was set up before. Submitted events update
+     * InputState_base<UinputBackend>, keys are tracked by evdev code, so
+     * no X server is needed for it either.
+     */
+    struct UinputBackend
+    {
+        static std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            static std::once_flag created;
+            std::call_once(created, [] {
+                if (!device().isOpen())
+                {
+                    device().create();
+                }
+            });
+
+            std::size_t sent = device().submit(events, count);
+            InputState_base<UinputBackend>::track(events, count);
+            return sent;
+        }
+
+        static UinputDevice& device()
+        {
+            static UinputDevice uinput;
+            return uinput;
+        }
+
+        /** Keys are tracked by evdev code, see InputState_base */
+        static std::size_t keyStateIndex(Key key)
+        {
+            std::size_t code = translateEvdevKey(key);
+            return code < KeyStateCount ? code : 0;
+        }
+    };
+}
+
+#endif
+#endif
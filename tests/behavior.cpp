@@ -0,0 +1,637 @@
+/**
+ * This file is part of the FakeInput library (https://github.com/uiii/FakeInput)
+ *
+ * Copyright (C) 2011 by Richard Jedlicka <uiii.dev@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Behavior tests of the event paths which need no desktop.
+ *
+ * Events go to RecordingBackend or, for uinput, into a pipe, and Xlib
+ * is replaced by the stubs of benchmark/stub_platform.hpp, so this runs
+ * on any Linux box without an X server or privileges:
+ *
+ *   g++ -O2 -std=c++20 -DUNIX -I.. -I../benchmark behavior.cpp -lpthread -lrt
+ *
+ * Prints one line per test and exits with 1 if any check failed.
+ *
+ * usage: behavior [filter]   runs the tests whose name contains filter
+ */
+
+#include "stub_platform.hpp"
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fakeinput/fakeinput.hpp"
+#include "fakeinput/coalescer.hpp"
+#include "fakeinput/coroutine.hpp"
+#include "fakeinput/injector.hpp"
+#include "fakeinput/macro.hpp"
+#include "fakeinput/ring.hpp"
+#include "fakeinput/scheduler.hpp"
+#include "fakeinput/shared_queue_linux.hpp"
+#include "fakeinput/state.hpp"
+#include "fakeinput/uinput_linux.hpp"
+
+using namespace FakeInput;
+
+namespace
+{
+    int failures = 0;
+    const char* currentTest = "";
+
+    /** Reports a failed check without stopping the test */
+    void check(bool isPassed, const char* what, int line)
+    {
+        if (!isPassed)
+        {
+            std::printf("  %s:%d: %s\n", currentTest, line, what);
+            ++failures;
+        }
+    }
+
+    #define CHECK(condition) check((condition), #condition, __LINE__)
+
+    Key keyOf(std::uint32_t keysym, std::uint8_t keycode)
+    {
+        Key key{};
+        key.virtualKey_ = keysym;
+        key.code_ = keycode;
+        return key;
+    }
+
+    InputEvent keyEvent(EventType type, Key key)
+    {
+        InputEvent event{};
+        event.type = type;
+        event.key = key;
+        return event;
+    }
+
+    InputEvent buttonEvent(EventType type, MouseButton button)
+    {
+        InputEvent event{};
+        event.type = type;
+        event.button = button;
+        return event;
+    }
+
+    InputEvent pointerEvent(EventType type, int x, int y)
+    {
+        InputEvent event{};
+        event.type = type;
+        event.x = x;
+        event.y = y;
+        return event;
+    }
+
+    bool isSame(const InputEvent& a, const InputEvent& b)
+    {
+        return a.type == b.type && a.button == b.button && a.x == b.x && a.y == b.y
+            && a.key.virtualKey_ == b.key.virtualKey_ && a.key.code_ == b.key.code_ && a.key.flags_ == b.key.flags_;
+    }
+
+    bool isSame(const std::vector<InputEvent>& a, const std::vector<InputEvent>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (!isSame(a[i], b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const Key KeyA = keyOf(XK_A, 38);
+    const Key KeyB = keyOf(XK_B, 56);
+    const Key KeyShift = keyOf(XK_Shift_L, 50);
+    const Key KeyF12 = keyOf(XK_F12, 96); // in the second word of the key bitset
+
+    void testSetStateDiff()
+    {
+        using State = InputState_base<RecordingBackend>;
+        RecordingBackend::clear();
+
+        State::setState(DesiredState().press(KeyA).press(KeyF12).press(Mouse_Left));
+        CHECK(State::isPressed(KeyA) && State::isPressed(KeyF12) && State::isPressed(Mouse_Left));
+        CHECK(RecordingBackend::events().size() == 3);
+
+        // A stays, F12 and Left go, Shift, B and Right come: all releases first
+        RecordingBackend::clear();
+        State::setState(DesiredState().press(KeyA).press(KeyShift).press(KeyB).press(Mouse_Right));
+        CHECK(isSame(RecordingBackend::events(), {
+            keyEvent(Event_KeyRelease, KeyF12),
+            buttonEvent(Event_ButtonRelease, Mouse_Left),
+            keyEvent(Event_KeyPress, KeyShift),
+            keyEvent(Event_KeyPress, KeyB),
+            buttonEvent(Event_ButtonPress, Mouse_Right)
+        }));
+
+        // the same state again sends nothing
+        RecordingBackend::clear();
+        CHECK(State::setState(DesiredState().press(KeyA).press(KeyShift).press(KeyB).press(Mouse_Right)) == 0);
+        CHECK(RecordingBackend::events().empty());
+
+        // events submitted directly are tracked as well
+        RecordingBackend::clear();
+        InputEvent release = keyEvent(Event_KeyRelease, KeyShift);
+        RecordingBackend::submit(&release, 1);
+        CHECK(!State::isPressed(KeyShift));
+
+        // buttons out of range are ignored
+        InputEvent unknown = buttonEvent(Event_ButtonRelease, static_cast<MouseButton>(MouseButtonCount));
+        RecordingBackend::submit(&unknown, 1);
+        CHECK(State::isPressed(Mouse_Right) && !DesiredState().press(unknown.button).isPressed(unknown.button));
+
+        RecordingBackend::clear();
+        State::releaseAll();
+        CHECK(isSame(RecordingBackend::events(), {
+            keyEvent(Event_KeyRelease, KeyA),
+            keyEvent(Event_KeyRelease, KeyB),
+            buttonEvent(Event_ButtonRelease, Mouse_Right)
+        }));
+        CHECK(!State::isPressed(KeyA) && !State::isPressed(Mouse_Right));
+        RecordingBackend::clear();
+    }
+
+    /** Reads the input_events written into the pipe so far */
+    std::vector<input_event> readEvdev(int fd)
+    {
+        std::vector<input_event> events;
+        input_event event;
+        while (::read(fd, &event, sizeof(event)) == static_cast<ssize_t>(sizeof(event)))
+        {
+            events.push_back(event);
+        }
+        return events;
+    }
+
+    bool isEvdev(const input_event& event, std::uint16_t type, std::uint16_t code, std::int32_t value)
+    {
+        return event.type == type && event.code == code && event.value == value;
+    }
+
+    void testUinputStream()
+    {
+        int fds[2];
+        CHECK(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+
+        UinputDevice& device = UinputBackend::device();
+        device.setScreenSize(1920, 1080);
+        device.attach(fds[1], true);
+
+        // X keycodes of the keys are ignored, key types translate by key symbol
+        InputEvent events[] = {
+            keyEvent(Event_KeyPress, keyOf(XK_Shift_L, 0)),
+            keyEvent(Event_KeyPress, keyOf(XK_a, 0)),
+            keyEvent(Event_KeyRelease, keyOf(XK_a, 0)),
+            buttonEvent(Event_ButtonPress, Mouse_Right),
+            pointerEvent(Event_Move, 5, -3),
+            pointerEvent(Event_MoveTo, 100, 5000),
+            pointerEvent(Event_MoveToNormalized, ScreenGeometry::NormalizedMax, 0),
+            pointerEvent(Event_Wheel, 0, -1),
+            keyEvent(Event_KeyPress, Key{}) // <no key> is dropped
+        };
+        CHECK(UinputBackend::submit(events, sizeof(events) / sizeof(*events)) == 8);
+
+        std::vector<input_event> written = readEvdev(fds[0]);
+        const input_event expected[] = {
+            { {}, EV_KEY, KEY_LEFTSHIFT, 1 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_KEY, KEY_A, 1 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_KEY, KEY_A, 0 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_KEY, BTN_RIGHT, 1 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_REL, REL_X, 5 }, { {}, EV_REL, REL_Y, -3 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_ABS, ABS_X, 100 }, { {}, EV_ABS, ABS_Y, 1079 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_ABS, ABS_X, 1919 }, { {}, EV_ABS, ABS_Y, 0 }, { {}, EV_SYN, SYN_REPORT, 0 },
+            { {}, EV_REL, REL_WHEEL, -1 }, { {}, EV_SYN, SYN_REPORT, 0 }
+        };
+        CHECK(written.size() == sizeof(expected) / sizeof(*expected));
+        for (std::size_t i = 0; i < written.size() && i < sizeof(expected) / sizeof(*expected); ++i)
+        {
+            CHECK(isEvdev(written[i], expected[i].type, expected[i].code, expected[i].value));
+        }
+
+        // what the backend pressed is released through it
+        using State = InputState_base<UinputBackend>;
+        CHECK(State::isPressed(keyOf(XK_Shift_L, 0)) && State::isPressed(Mouse_Right));
+        State::releaseAll();
+        written = readEvdev(fds[0]);
+        CHECK(written.size() == 4);
+        CHECK(written.size() == 4 && isEvdev(written[0], EV_KEY, KEY_LEFTSHIFT, 0) && isEvdev(written[2], EV_KEY, BTN_RIGHT, 0));
+
+        device.close();
+        ::close(fds[0]);
+    }
+
+    void testMacroRoundTrip()
+    {
+        MacroWriter writer;
+        writer.pressKey(KeyShift);
+        MacroWriter::Label loop = writer.label();
+        writer.pressKey(KeyA).releaseKey(KeyA).move(-7, 300);
+        writer.repeat(loop, 3);
+        writer.releaseKey(KeyShift).pressButton(Mouse_Middle).releaseButton(Mouse_Middle)
+            .moveTo(123456, -1).wheelUp().waitMicroseconds(10).wheelDown();
+
+        std::vector<InputEvent> expected = { keyEvent(Event_KeyPress, KeyShift) };
+        for (int i = 0; i < 3; ++i)
+        {
+            expected.push_back(keyEvent(Event_KeyPress, KeyA));
+            expected.push_back(keyEvent(Event_KeyRelease, KeyA));
+            expected.push_back(pointerEvent(Event_Move, -7, 300));
+        }
+        expected.push_back(keyEvent(Event_KeyRelease, KeyShift));
+        expected.push_back(buttonEvent(Event_ButtonPress, Mouse_Middle));
+        expected.push_back(buttonEvent(Event_ButtonRelease, Mouse_Middle));
+        expected.push_back(pointerEvent(Event_MoveTo, 123456, -1));
+        expected.push_back(pointerEvent(Event_Wheel, 0, 1));
+        expected.push_back(pointerEvent(Event_Wheel, 0, -1));
+
+        RecordingBackend::clear();
+        MacroPlayer_base<RecordingBackend> player;
+        std::vector<std::uint8_t> macro = writer.finish();
+        CHECK(player.play(macro) == expected.size());
+        CHECK(isSame(RecordingBackend::events(), expected));
+
+        // a truncated macro plays up to the last whole instruction
+        RecordingBackend::clear();
+        macro.erase(macro.end() - 2, macro.end()); // reports the truncated event on stderr
+        player.play(macro);
+        expected.pop_back();
+        CHECK(isSame(RecordingBackend::events(), expected));
+        RecordingBackend::clear();
+    }
+
+    void testMacroIdleLoops()
+    {
+        // a loop of waits only sleeps them instead of spinning until stop()
+        MacroWriter waits;
+        MacroWriter::Label loop = waits.label();
+        waits.waitMicroseconds(1000);
+        waits.repeat(loop, 0);
+        std::vector<std::uint8_t> macro = waits.finish();
+
+        MacroPlayer_base<RecordingBackend> player;
+        std::int64_t cpu = 0;
+        std::thread playing([&] {
+            timespec start;
+            timespec end;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+            player.play(macro);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+            cpu = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+        });
+        sleepUntil(monotonicTime() + 50000000);
+        player.stop();
+        playing.join();
+        CHECK(cpu < 25000000);
+
+        // a loop of nothing ends the playback
+        MacroWriter empty;
+        empty.pressKey(KeyA);
+        MacroWriter::Label nothing = empty.label();
+        empty.jump(nothing);
+        RecordingBackend::clear();
+        CHECK(player.play(empty.finish()) == 1); // reports the loop on stderr
+        CHECK(isSame(RecordingBackend::events(), { keyEvent(Event_KeyPress, KeyA) }));
+        RecordingBackend::clear();
+    }
+
+    void testMpscRingWraparound()
+    {
+        MpscRing<std::uint64_t> ring(4);
+
+        std::uint64_t pushed = 0;
+        std::uint64_t popped = 0;
+        for (int lap = 0; lap < 1000; ++lap)
+        {
+            // fill up, one push too many, then drain a lap-dependent part
+            while (ring.tryPush(pushed))
+            {
+                ++pushed;
+            }
+            CHECK(pushed - popped == 4);
+
+            std::uint64_t value = 0;
+            for (int i = 0; i < 1 + lap % 4 && ring.tryPop(value); ++i)
+            {
+                CHECK(value == popped);
+                ++popped;
+            }
+        }
+
+        std::uint64_t value = 0;
+        while (ring.tryPop(value))
+        {
+            CHECK(value == popped);
+            ++popped;
+        }
+        CHECK(popped == pushed && !ring.tryPop(value));
+    }
+
+    void testSharedQueueWraparound()
+    {
+        std::string name = "/fakeinput-behavior-" + std::to_string(getpid());
+        SharedInputQueue consumer;
+        SharedInputQueue producer;
+        CHECK(consumer.create(name, 8) && producer.open(name));
+        CHECK(producer.capacity() == 8);
+
+        int posted = 0;
+        int drained = 0;
+        for (int lap = 0; lap < 100; ++lap)
+        {
+            InputEvent events[11];
+            for (int i = 0; i < 11; ++i)
+            {
+                events[i] = pointerEvent(Event_Move, posted + i, lap);
+            }
+            std::size_t count = producer.post(events, 11); // stops where the queue is full
+            CHECK(count == 8);
+            posted += static_cast<int>(count);
+
+            InputEvent out[8];
+            std::size_t size = consumer.drain(out, 3 + lap % 6);
+            while (size > 0)
+            {
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    CHECK(out[i].x == drained);
+                    ++drained;
+                }
+                size = consumer.drain(out, 8);
+            }
+        }
+        CHECK(drained == posted);
+    }
+
+    /** Keeps what an injector thread submits, RecordingBackend is per thread.
+     *
+     * Read it only after the injector thread stopped.
+     */
+    struct ThreadBackend
+    {
+        static std::size_t submit(const InputEvent* events, std::size_t count)
+        {
+            submitted.insert(submitted.end(), events, events + count);
+            return count;
+        }
+
+        static inline std::vector<InputEvent> submitted;
+    };
+
+    void testSharedInjectorDropsInvalid()
+    {
+        std::string name = "/fakeinput-behavior-injector-" + std::to_string(getpid());
+        SharedInjector_base<ThreadBackend> injector(name, 8);
+        SharedInputQueue producer;
+        CHECK(injector.isRunning() && producer.open(name));
+
+        // other processes may store any value in the enums
+        InputEvent events[4] = {
+            pointerEvent(Event_Move, 1, 0), buttonEvent(Event_ButtonPress, Mouse_Left),
+            pointerEvent(Event_Move, 2, 0), buttonEvent(Event_ButtonPress, Mouse_Left)
+        };
+        int badType = Event_UnicodeRelease + 1;
+        int badButton = 40;
+        std::memcpy(&events[1].button, &badButton, sizeof(badButton));
+        std::memcpy(&events[3].type, &badType, sizeof(badType));
+        CHECK(producer.post(events, 4) == 4);
+        injector.stop();
+
+        CHECK(injector.submittedCount() == 2 && injector.droppedCount() == 2);
+        CHECK(isSame(ThreadBackend::submitted, { pointerEvent(Event_Move, 1, 0), pointerEvent(Event_Move, 2, 0) }));
+    }
+
+    void testCoalescerMotion()
+    {
+        RecordingBackend::clear();
+        MotionCoalescer_base<RecordingBackend> coalescer(1000000000);
+
+        // moves wait for the window, whole pixels go right before the next event
+        coalescer.move(0.6, 0);
+        coalescer.move(0.6, -1.5);
+        CHECK(RecordingBackend::events().empty());
+        coalescer.pressButton(Mouse_Left);
+        CHECK(isSame(RecordingBackend::events(), { pointerEvent(Event_Move, 1, -1), buttonEvent(Event_ButtonPress, Mouse_Left) }));
+        CHECK(coalescer.pendingX() > 0.19 && coalescer.pendingX() < 0.21 && coalescer.pendingY() == -0.5);
+
+        // the remainder alone is no motion, an absolute move drops it
+        RecordingBackend::clear();
+        CHECK(!coalescer.flush());
+        coalescer.move(0.6, 0);
+        coalescer.moveTo(10, 20);
+        CHECK(coalescer.pendingX() == 0 && coalescer.pendingY() == 0);
+        CHECK(isSame(RecordingBackend::events(), { pointerEvent(Event_MoveTo, 10, 20) }));
+
+        // without window every whole pixel goes at once
+        RecordingBackend::clear();
+        MotionCoalescer_base<RecordingBackend> immediate(0);
+        immediate.move(2.5, 0);
+        CHECK(isSame(RecordingBackend::events(), { pointerEvent(Event_Move, 2, 0) }));
+        RecordingBackend::clear();
+    }
+
+    void testInjectorOrder()
+    {
+        ThreadBackend::submitted.clear();
+        Injector_base<ThreadBackend> injector(8);
+        injector.pressKey(KeyA);
+        for (int i = 0; i < 20; ++i)
+        {
+            injector.move(1, 2);
+        }
+        injector.releaseKey(KeyA);
+        injector.pressButton(Mouse_Left);
+        injector.stop();
+
+        // adjacent moves are merged in any split the thread drained them
+        std::vector<InputEvent> merged;
+        for (const InputEvent& event : ThreadBackend::submitted)
+        {
+            if (event.type == Event_Move && !merged.empty() && merged.back().type == Event_Move)
+            {
+                merged.back().x += event.x;
+                merged.back().y += event.y;
+                continue;
+            }
+            merged.push_back(event);
+        }
+        CHECK(ThreadBackend::submitted.size() < 23);
+        CHECK(isSame(merged, {
+            keyEvent(Event_KeyPress, KeyA),
+            pointerEvent(Event_Move, 20, 40),
+            keyEvent(Event_KeyRelease, KeyA),
+            buttonEvent(Event_ButtonPress, Mouse_Left)
+        }));
+        CHECK(injector.droppedCount() == 0);
+    }
+
+    void testSchedulerOrder()
+    {
+        RecordingBackend::clear();
+        Scheduler_base<RecordingBackend> scheduler(0);
+
+        std::int64_t start = monotonicTime() + 1000000;
+        scheduler.schedule(start + 3000000, pointerEvent(Event_Move, 3, 0));
+        scheduler.schedule(start + 1000000, pointerEvent(Event_Move, 1, 0));
+        scheduler.schedule(start + 2000000, pointerEvent(Event_Move, 2, 0));
+        scheduler.schedule(start + 1000000, pointerEvent(Event_Move, 1, 1)); // same deadline keeps its order
+        scheduler.scheduleAfter(500000, pointerEvent(Event_Move, 4, 0)); // after the latest one
+
+        CHECK(scheduler.run() == 5);
+        CHECK(isSame(RecordingBackend::events(), {
+            pointerEvent(Event_Move, 1, 0),
+            pointerEvent(Event_Move, 1, 1),
+            pointerEvent(Event_Move, 2, 0),
+            pointerEvent(Event_Move, 3, 0),
+            pointerEvent(Event_Move, 4, 0)
+        }));
+        CHECK(scheduler.lateness().size() == 5 && scheduler.lateness().front() >= 0);
+        CHECK(monotonicTime() >= start + 3500000);
+        RecordingBackend::clear();
+    }
+
+    using Loop = InputLoop_base<RecordingBackend>;
+
+    InputTask typeWithPause(Loop& loop)
+    {
+        co_await loop.keyboard.tap(KeyA);
+        co_await loop.after(std::chrono::milliseconds(4));
+        co_await loop.keyboard.tap(KeyB);
+    }
+
+    InputTask clickInBetween(Loop& loop)
+    {
+        co_await loop.after(std::chrono::milliseconds(2));
+        co_await loop.mouse.click(Mouse_Left);
+        co_await loop.mouse.move(1, 2);
+    }
+
+    void testCoroutineOrder()
+    {
+        RecordingBackend::clear();
+        Loop loop;
+        loop.spawn(typeWithPause(loop));
+        loop.spawn(clickInBetween(loop));
+        loop.run();
+
+        CHECK(loop.size() == 0);
+        CHECK(isSame(RecordingBackend::events(), {
+            keyEvent(Event_KeyPress, KeyA),
+            keyEvent(Event_KeyRelease, KeyA),
+            buttonEvent(Event_ButtonPress, Mouse_Left),
+            buttonEvent(Event_ButtonRelease, Mouse_Left),
+            pointerEvent(Event_Move, 1, 2),
+            keyEvent(Event_KeyPress, KeyB),
+            keyEvent(Event_KeyRelease, KeyB)
+        }));
+        RecordingBackend::clear();
+    }
+
+    InputTask moveUntil(Loop& loop, const bool& isDone, int& moves)
+    {
+        while (!isDone && moves < 100000)
+        {
+            co_await loop.mouse.move(1, 0);
+            ++moves;
+        }
+    }
+
+    InputTask finishAfter(Loop& loop, bool& isDone)
+    {
+        co_await loop.after(std::chrono::milliseconds(2));
+        isDone = true;
+    }
+
+    void testCoroutineTimerFairness()
+    {
+        RecordingBackend::clear();
+        Loop loop;
+        bool isDone = false;
+        int moves = 0;
+        std::int64_t start = monotonicTime();
+        loop.spawn(moveUntil(loop, isDone, moves));
+        loop.spawn(finishAfter(loop, isDone));
+        loop.run();
+
+        // the timer fires while the other sequence keeps awaiting input
+        CHECK(isDone && moves < 100000);
+        CHECK(monotonicTime() - start >= 2000000);
+        RecordingBackend::clear();
+    }
+
+    struct Test
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const Test tests[] = {
+        { "setState.diff", testSetStateDiff },
+        { "uinput.stream", testUinputStream },
+        { "macro.roundTrip", testMacroRoundTrip },
+        { "macro.idleLoops", testMacroIdleLoops },
+        { "mpscRing.wraparound", testMpscRingWraparound },
+        { "sharedQueue.wraparound", testSharedQueueWraparound },
+        { "sharedInjector.dropsInvalid", testSharedInjectorDropsInvalid },
+        { "coalescer.motion", testCoalescerMotion },
+        { "injector.order", testInjectorOrder },
+        { "scheduler.order", testSchedulerOrder },
+        { "coroutine.order", testCoroutineOrder },
+        { "coroutine.timerFairness", testCoroutineTimerFairness }
+    };
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    for (const Test& test : tests)
+    {
+        if (!std::strstr(test.name, filter))
+        {
+            continue;
+        }
+
+        currentTest = test.name;
+        int before = failures;
+        test.run();
+        std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", test.name);
+    }
+
+    return failures == 0 ? 0 : 1;
+}